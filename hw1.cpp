@@ -9,27 +9,116 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <algorithm>
+#include <thread>
+#include <new>
+#include <cstddef>
+#include <memory>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <charconv>
+#include <locale>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <variant>
 
 class Board;
+class ThingPool;
+class ParticleSink;
+class TextWriter;
+
+
+
+/** @class LifecycleTrace
+ @brief Records construct, copy and destruct events of Things in a fixed-size lock-free ring buffer. When the ring is full the oldest events are overwritten. The events can be dumped to a compact binary file afterwards.
+ */
+class LifecycleTrace {
+public:
+    enum Event : uint8_t {CONSTRUCT, COPY, DESTRUCT};
+    enum Kind : uint8_t {THING_A, THING_B};
+    
+    static void record(Event event, Kind kind, int id);
+    static bool dump(const std::string& filename);
+    static uint64_t recorded() {return next.load(std::memory_order_relaxed);};
+    
+private:
+    static constexpr size_t CAPACITY = 1 << 16; // events kept, a power of two
+    
+    struct Slot {
+        std::atomic<uint64_t> stamp; // sequence number + 1 once the payload is complete, 0 while it is written
+        std::atomic<uint64_t> payload; // id in the low 32 bits, then event and kind
+    };
+    
+    static std::atomic<uint64_t> next; // sequence number of the next event
+    static Slot ring[CAPACITY];
+};
+
+std::atomic<uint64_t> LifecycleTrace::next(0);
+LifecycleTrace::Slot LifecycleTrace::ring[LifecycleTrace::CAPACITY];
+
+
+
+/** @struct NoTrace
+ @brief Tracing policy that discards every event, so the calls compile to nothing
+ */
+struct NoTrace {
+    static void record(LifecycleTrace::Event, LifecycleTrace::Kind, int) {};
+};
+
+#ifdef BOARD_TRACE
+typedef LifecycleTrace TracePolicy; // compile with -DBOARD_TRACE to record Thing lifecycles
+#else
+typedef NoTrace TracePolicy;
+#endif
+
+
+/** @struct BoardLink
+ @brief Records where a Board currently lives. Each Board owns one on the heap and its particles point to it, so moving a Board only has to update the link, not every particle.
+ */
+struct BoardLink {
+    const Board* board;
+};
+
 
 
 /** @class Thing
- @brief Base class for particle. Stores a position.
+ @brief Base class for particle. Stores a position and a link to the Board it belongs to.
  */
 class Thing {
 public:
-    Thing(int pos) : position(pos) {};
+    Thing(int pos, const Board& b);
+    const Board& get_board() const {return *link->board;};
     virtual Thing* clone() const = 0;
+    virtual Thing* clone(ThingPool& pool) const = 0;
     virtual int get_position() const {return position;};
+    int get_id() const {return ID;};
+    virtual char get_type() const = 0;
     virtual void print(std::ostream& out) const {};
+    virtual void print(TextWriter&) const {}
     virtual ~Thing() {};
 protected:
+    static int next_id();
     int position;
-    static int IDgen;
+    const BoardLink* link; // rebound by Board when a copy takes the particle over
+    static std::atomic<int> IDgen; // last ID handed out to any thread's block
+    static constexpr int ID_BLOCK = 1024; // IDs claimed from IDgen at a time
     int ID;
+    
+    friend class Board;
 };
 
-int Thing::IDgen = 0; // initializing static int IDgen with 0
+std::atomic<int> Thing::IDgen(0); // initializing static int IDgen with 0
 
 
 /** @class ThingA
@@ -40,13 +129,15 @@ public:
     ThingA(int pos, std::string prop, const Board& b); // regular constructor
     ThingA(const ThingA& thing); // copy constructor
     void print(std::ostream& out) const;
+    void print(TextWriter& out) const;
+    char get_type() const {return 'A';};
+    const std::string& get_property() const {return property;};
     virtual ~ThingA();
     ThingA* clone() const; // clone idiom
+    ThingA* clone(ThingPool& pool) const; // clone idiom, allocating from a pool
 
 private:
     std::string property;
-    const Board& board;
-    int ID;
 };
 
 
@@ -59,299 +150,3743 @@ public:
     ThingB(int pos, double prop, const Board& b); // regular constructor
     ThingB(const ThingB& thing); // copy constructor
     void print(std::ostream& out) const;
+    void print(TextWriter& out) const;
+    char get_type() const {return 'B';};
+    double get_property() const {return property;};
     virtual ~ThingB();
     ThingB* clone() const; // clone idiom
+    ThingB* clone(ThingPool& pool) const; // clone idiom, allocating from a pool
     
 private:
     double property;
-    const Board& board;
-    int ID;
 };
 
 
 
-/** @class Board
- @brief Stores a collection of particles
+/** @class TextWriter
+ @brief Formats text into a large buffer that is handed to a stream or file descriptor only when it fills up or on flush. Numbers are formatted with std::to_chars, which prints the same characters as an ostream with default flags.
  */
-class Board {
+class TextWriter {
 public:
-    Board() {}; // default constructor
-    Board(const Board& copy); // copy constructor
-    void swap (Board& other);
-    Board& operator=(Board copy); // copy/swap idiom
+    TextWriter(std::ostream& stream);
+    TextWriter(int file_descriptor);
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+    ~TextWriter();
     
-    bool ParticleInPosition(int pos) const;
-    void AddAParticle(int pos, std::string prop);
-    bool AddBParticle(int pos, double prop);
-    bool operator[](int n);
-    bool operator()();
+    void write(const char* s, size_t n);
+    void write(const std::string& s) {write(s.data(), s.size());};
+    void write(char c);
+    void write(int n);
+    void write(double x);
+    bool flush();
     
-    virtual ~Board();
+    static bool formats_like(const std::ostream& out);
     
-    friend std::ostream& operator<<(std::ostream& out, const Board& board);
 private:
-    std::vector<Thing*> things;
+    static constexpr size_t CAPACITY = 1 << 16;
+    char* reserve(size_t n);
+    void send(const char* s, size_t n);
+    
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+    std::ostream* stream; // null when writing to fd
+    int fd;
+    int precision; // significant digits for doubles, as std::ostream::precision
+    bool ok;
 };
 
 
 
-int main() {
-    Board Z;
-    Z.AddAParticle(0, "red");
-    Z.AddBParticle(9, 2.71828);
+/** @class ThingPool
+ @brief Arena that hands out memory for Things from large blocks. Memory given back piece by piece goes on a free list for its size and is handed out again before the blocks are touched; the blocks themselves are released at once when the pool is destroyed.
+ */
+class ThingPool {
+public:
+    ThingPool() : current(nullptr), remaining(0), used(0) {};
+    ThingPool(const ThingPool&) = delete;
+    ThingPool& operator=(const ThingPool&) = delete;
+    ~ThingPool();
     
-    Board Y(Z);
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+    void reserve(size_t bytes);
+    void reserve(size_t count, size_t size);
+    void swap(ThingPool& other);
+    void absorb(ThingPool& other);
+    size_t bytes_used() const {return used;};
     
-    Y.AddAParticle(2, "green");
+    static std::atomic<size_t> blocks_allocated; // blocks requested from the system by all pools, for measurement
     
-    Y = Z;
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    static size_t round_up(size_t size);
     
-    return 0;
-}
+    struct FreeList {
+        size_t size; // rounded size of every chunk on the list
+        void* head; // each free chunk starts with a pointer to the next
+    };
+    
+    std::vector<char*> blocks;
+    std::vector<FreeList> free_lists; // one per object size given back, so only a few
+    char* current; // next free byte in the newest block
+    size_t remaining; // free bytes left in the newest block
+    size_t used; // bytes handed out and not given back
+};
 
+std::atomic<size_t> ThingPool::blocks_allocated(0);
 
 
-/** Constructor for ThingA object
- @param pos is the position 
- @param prop is the string property
- @param b is the Board on which the ThingA is located
+
+/** Scrambles the bits of a position so that nearby positions spread evenly over hash partitions (murmur3 finalizer)
+ @param pos is the position
+ @return the hash
  */
-ThingA::ThingA(int pos, std::string prop, const Board& b) : Thing(pos), property(prop), board(b) {
-    ID = ++IDgen; // creates unique ID
-    std::cout << "Constructing ThingA #" << ID << std::endl; // prints out construction
-};
+inline uint32_t mix_position(int pos) {
+    uint32_t h = static_cast<uint32_t>(pos);
+    h ^= h >> 16; h *= 0x85EBCA6Bu; h ^= h >> 13; h *= 0xC2B2AE35u; h ^= h >> 16;
+    return h;
+}
 
 
 
-/** Copy constructor for ThingA object
- @param thing whose values will be used to initialize object
+/** Returns the slot where the probe sequence of a key starts in a power-of-two hash table (Fibonacci hashing)
+ @param key is the key
+ @param mask is the table size minus one
+ @return the index of the slot
  */
-ThingA::ThingA(const ThingA& thing) : Thing(thing.position), property(thing.property), board(thing.board) {
-    ID = ++IDgen; // creates unique ID
-    std::cout << "Constructing ThingA #" << ID << std::endl; // prints out construction
+inline size_t fibonacci_slot(int key, size_t mask) {
+    return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
 }
 
 
 
-/** Destructor for ThingA object
+/** @class PositionIndex
+ @brief Open-addressing hash map from a position to the number of particles stored at that position. Uses linear probing over a power-of-two table. Each entry can also hold a slot, which a Board uses as the head of the chain of particles at the position.
  */
-ThingA::~ThingA() {
-    std::cout << "Destructing ThingA #" << ID << std::endl; // prints out destruction
-}
+class PositionIndex {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX; // head of a position without a chain
+    
+    PositionIndex() : used(0) {};
+    int count(int pos) const;
+    uint32_t head(int pos) const;
+    void insert(int pos);
+    uint32_t insert(int pos, uint32_t head);
+    bool insert_new(int pos, uint32_t head);
+    void set_head(int pos, uint32_t head);
+    void clear_heads();
+    bool erase(int pos);
+    void clear();
+    void reserve(size_t n);
+    void swap(PositionIndex& other);
+    void partition(const std::function<bool(int)>& pred, PositionIndex& yes, PositionIndex& no) const;
+    size_t size() const {return used;}; // number of distinct positions
+    
+private:
+    struct Slot {
+        int key;
+        int count; // 0 marks an empty slot
+        uint32_t head;
+    };
+    size_t home_slot(int pos) const;
+    size_t find_slot(int pos) const;
+    void rehash(size_t capacity);
+    
+    std::vector<Slot> slots;
+    size_t used;
+};
 
 
 
-/** Constructor for ThingB object
- @param pos is the position
- @param prop is the double property
- @param b is the Board on which the ThingB is located
+/** @class SlotIndex
+ @brief Open-addressing hash map from an int key to a uint32_t slot, with the same linear probing over a power-of-two table as PositionIndex
  */
-ThingB::ThingB(int pos, double prop, const Board& b) : Thing(pos), property(prop), board(b) {
-    ID = ++IDgen; // creates unique ID
-    std::cout << "Constructing ThingB #" << ID << std::endl; // prints out construction
+class SlotIndex {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX; // marks an empty slot, and a key that is not found
+    
+    SlotIndex() : used(0) {};
+    uint32_t find(int key) const;
+    void assign(int key, uint32_t value);
+    bool erase(int key);
+    void reserve(size_t n);
+    void swap(SlotIndex& other);
+    size_t size() const {return used;};
+    
+private:
+    struct Slot {
+        int key;
+        uint32_t value;
+    };
+    size_t find_slot(int key) const;
+    void rehash(size_t capacity);
+    
+    std::vector<Slot> slots;
+    size_t used;
 };
 
 
 
-/** Copy constructor for ThingB object
- @param thing whose values will be used to initialize object
+/** @class RangeIndex
+ @brief Ordered index of (position, ID) pairs for range queries. New entries wait in an unsorted buffer and are merged into the sorted array on the next query, so adding stays O(1) and queries are binary searches. Erased entries likewise wait in a buffer and are compacted out on the next query. Entries name particles by ID, which stays put when a Board moves particles between slots.
  */
-ThingB::ThingB(const ThingB& thing) : Thing(thing.position), property(thing.property), board(thing.board) {
-    ID = ++IDgen; // creates unique ID
-    std::cout << "Constructing ThingB #" << ID << std::endl; // prints out contruction
-}
+class RangeIndex {
+public:
+    RangeIndex() {};
+    void insert(int pos, int id);
+    void erase(int pos, int id);
+    void reserve(size_t n);
+    void swap(RangeIndex& other);
+    void rename(const std::function<int(int)>& new_id);
+    void settle() const;
+    size_t count(int lo, int hi) const;
+    std::vector<int> find(int lo, int hi) const;
+    
+private:
+    struct Entry {
+        int position;
+        int id;
+        bool operator<(const Entry& rhs) const {return position < rhs.position || (position == rhs.position && id < rhs.id);};
+        bool operator==(const Entry& rhs) const {return position == rhs.position && id == rhs.id;};
+    };
+    
+    // all three are settled lazily from const queries, so concurrent queries need outside locking
+    mutable std::vector<Entry> sorted;
+    mutable std::vector<Entry> pending;
+    mutable std::vector<Entry> removed;
+};
 
 
 
-/** Destructor for ThingB object
+/** @struct CollisionGroup
+ @brief A position shared by more than one particle, along with the slots of the particles sharing it
  */
-ThingB::~ThingB() {
-    std::cout << "Destructing ThingB #" << ID << std::endl; // prints out destruction
-}
+struct CollisionGroup {
+    int position;
+    std::vector<size_t> slots;
+};
 
 
 
-/** Prints out the type, position, and property of a ThingA object
- @param out is the output stream
+/** @class CollisionDetector
+ @brief Finds every position shared by more than one particle in a contiguous array of positions. With more than one thread, positions are hashed into one partition per thread and each partition is searched independently.
  */
-void ThingA::print(std::ostream& out) const {
-    out << "A:" << get_position() << ":" << property;
-}
+class CollisionDetector {
+public:
+    /** Calls a task once for every thread number from 0 to the detector's thread count, concurrently, and returns when all calls have */
+    typedef std::function<void(const std::function<void(unsigned)>& task)> Runner;
+    
+    CollisionDetector(unsigned n_threads = 1) : threads(n_threads == 0 ? 1 : n_threads) {};
+    bool any(const std::vector<int>& positions) const;
+    std::vector<CollisionGroup> groups(const std::vector<int>& positions) const;
+    std::vector<CollisionGroup> groups(const std::vector<int>& positions, const Runner& run) const;
+    
+private:
+    void find_in_partition(const std::vector<int>& positions, const std::vector<size_t>& slots, std::vector<CollisionGroup>& out) const;
+    unsigned threads;
+};
 
 
 
-/** Prints out the type, position, and property of a ThingB object
- @param out is the output stream
+/** @struct ARecord
+ @brief Position and property of one A particle, for batch ingestion
  */
-void ThingB::print(std::ostream& out) const {
-    out << "B:" << get_position() << ":" << property;
-}
+struct ARecord {
+    int position;
+    std::string property;
+};
 
 
 
-/** Creates a clone of ThingA object on the heap
- @return a pointer to the clone
+/** @struct BRecord
+ @brief Position and property of one B particle, for batch ingestion
  */
-ThingA* ThingA::clone() const {
-    
-    ThingA* thing = nullptr;
-    try {
-        thing = new ThingA (*this); // try allocating memory on heap
-    }
-    catch (std::exception& e) {
-        std::cerr << "Failure at ThingA::clone()" << std::endl;
-        thing = nullptr;
-    }
-    return thing;
-}
+struct BRecord {
+    int position;
+    double property;
+};
 
 
 
-/** Creates a clone of ThingB object on the heap
- @return a pointer to the clone
+/** @class Board
+ @brief Stores a collection of particles
  */
-ThingB* ThingB::clone() const {
+class Board {
+public:
+    Board() {}; // default constructor
+    Board(const Board& copy); // copy constructor
+    Board(Board&& other) noexcept; // move constructor
+    void swap (Board& other) noexcept;
+    Board& operator=(Board copy) noexcept; // copy/swap idiom, also serves as move assignment
     
-    ThingB* thing = nullptr;
-    try {
-        thing = new ThingB (*this); // try allocating memory on heap
-    }
-    catch (std::exception& e) {
-        std::cerr << "Failure at ThingB::clone()" << std::endl;
-        thing = nullptr;
-    }
-    return thing;
-}
+    bool ParticleInPosition(int pos) const;
+    void AddAParticle(int pos, std::string prop);
+    bool AddBParticle(int pos, double prop);
+    void AddAParticles(const std::vector<ARecord>& records);
+    std::vector<size_t> AddBParticles(const std::vector<BRecord>& records);
+    size_t RemoveParticlesAt(int pos);
+    bool RemoveParticle(int id);
+    size_t RemoveParticlesIf(const std::function<bool(const Thing&)>& pred);
+    bool operator[](int n);
+    bool operator()();
+    std::vector<int> Positions() const;
+    std::vector<CollisionGroup> Collisions(unsigned n_threads = 1) const;
+    size_t CountInRange(int lo, int hi) const;
+    std::vector<const Thing*> ParticlesInRange(int lo, int hi) const;
+    bool SaveSnapshot(const std::string& filename) const;
+    bool Export(int fd) const;
+    size_t AddParticlesConcurrently(const std::vector<std::function<void(ParticleSink&)>>& producers);
+    
+    virtual ~Board();
+    
+    friend std::ostream& operator<<(std::ostream& out, const Board& board);
+    friend class BoardSnapshot;
+    friend class Thing;
+    friend class Simulation;
+#ifdef BOARD_BENCHMARK
+    friend void benchmark_copy(int n);
+#endif
+private:
+    const BoardLink* shared_link() const;
+    void copy_indexes(const Board& copy);
+    void adopt(Thing* thing);
+    void remove_slot(size_t slot);
+    void unlink(size_t slot);
+    void destroy(Thing* thing);
+    void rechain();
+    void relocate(const std::vector<int>& positions);
+    
+    std::vector<Thing*> things; // constructed in pool, given back to it when removed
+    ThingPool pool;
+    PositionIndex index; // position -> number of particles and the slot heading their chain, kept in sync with things
+    RangeIndex ordered; // positions in order, kept in sync with things
+    SlotIndex ids; // particle ID -> slot
+    std::vector<uint32_t> next_here; // slot -> next slot with the same position, or SlotIndex::NONE
+    std::vector<uint32_t> prev_here; // slot -> previous slot with the same position, or SlotIndex::NONE
+    mutable std::unique_ptr<BoardLink> link; // created for the first particle, moves with the particles
+};
 
 
 
-/** Copy constructor for Board object
- @param copy is the Board used to initialize object
+/** @class ParticleSink
+ @brief Collects the particles made by one producer thread during Board::AddParticlesConcurrently. Each sink has its own pool, so producers never share state.
  */
-Board::Board(const Board& copy) {
+class ParticleSink {
+public:
+    ParticleSink(const Board& b) : board(b) {};
+    ParticleSink(const ParticleSink&) = delete;
+    ParticleSink& operator=(const ParticleSink&) = delete;
+    ~ParticleSink();
     
-    for (size_t i = 0, n = copy.things.size(); i < n; ++i) {
+    void AddAParticle(int pos, std::string prop);
+    void AddBParticle(int pos, double prop); // kept only if its position is still free when the sink is merged
     
-        Thing* thing = copy.things[i]->clone();
-        things.push_back(thing);
-    }
-}
+private:
+    void make_room();
+    
+    const Board& board;
+    ThingPool pool;
+    std::vector<Thing*> things;
+    std::vector<bool> exclusive; // true for B particles
+    
+    friend class Board;
+};
 
 
 
-/** Swaps two Boards
- @param other is the board to be swapped with
+/** @class Simulation
+ @brief Steps the particles of a Board through time on several threads. Positions are copied out of the Board once into two contiguous arrays; each tick the update rule reads the current array and writes the next one in parallel chunks, and the arrays then swap roles. Positions are written back to the Board by sync().
+ 
+ After every step, a B particle that moved onto a position held by any other particle is sent back to where it was, as AddBParticle would refuse it; the remaining collisions are then found with CollisionDetector. Both checks are split over the threads by position hash.
  */
-void Board::swap(Board& other) {
-    std::swap(things, other.things);
-}
+class Simulation {
+public:
+    /** Computes next[i] from current[i] for every slot i in [first, last) */
+    typedef std::function<void(const int* current, int* next, size_t first, size_t last, uint64_t tick)> UpdateRule;
+    
+    /** Time spent in each phase of one tick, in seconds */
+    struct TickStats {
+        double update;
+        double exclusivity;
+        double collisions;
+        double total;
+        size_t reverted; // B moves undone
+        size_t collision_groups;
+    };
+    
+    Simulation(Board& b, UpdateRule update_rule, unsigned n_threads = 1);
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+    ~Simulation();
+    
+    void step();
+    void run(size_t ticks);
+    void sync();
+    
+    uint64_t tick() const {return ticks_done;};
+    const std::vector<int>& Positions() const {return current;};
+    const std::vector<CollisionGroup>& Collisions() const {return collisions;};
+    const std::vector<TickStats>& Stats() const {return stats;};
+    
+private:
+    void work(unsigned t);
+    void run_pass(const std::function<void(unsigned)>& task);
+    void run_chunks();
+    size_t enforce_exclusivity();
+    
+    Board& board;
+    UpdateRule rule;
+    unsigned threads;
+    std::vector<int> current; // positions at the start of the tick
+    std::vector<int> next; // positions being computed
+    std::vector<bool> exclusive; // true for B particles
+    std::vector<CollisionGroup> collisions; // found at the end of the last tick
+    std::vector<TickStats> stats;
+    uint64_t ticks_done;
+    
+    // exclusivity state, one entry per thread and kept across ticks so the tables are not reallocated
+    std::vector<PositionIndex> occupancy; // counts of the next positions that hash to the thread, each heading a chain of the B moves onto it
+    std::vector<std::vector<int>> check; // positions of the thread that may have become shared
+    std::vector<std::vector<size_t>> undone; // moves the thread undid in the current round
+    std::vector<uint32_t> next_mover; // slot -> next B move onto the same position, or PositionIndex::NONE
+    
+    // persistent workers: a new generation starts every pass, and the main thread waits until all have finished
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_pass;
+    std::condition_variable end_pass;
+    const std::function<void(unsigned)>* task; // work of the current pass, called with the worker's number
+    std::exception_ptr failure; // first exception thrown by a worker during the current pass
+    uint64_t generation;
+    unsigned running;
+    bool stopping;
+};
 
 
 
-/** Overloaded operator= for Board
- @param copy is the Board object to be set equal to
- @return the Board object
+/** @class BoardSnapshot
+ @brief Read-only view of a Board saved with Board::SaveSnapshot. Opening a snapshot only memory-maps the file and checks its header; particles are read straight from the mapping, and Things are constructed only when the snapshot is added to a Board.
+ 
+ The file starts with a 32-byte header: the magic "BRDS", the format version, the particle count and the size of the string heap. Then comes one 16-byte record per particle (position, type, and either the B property or the offset and length of the A property in the heap), followed by the heap. Integers are stored in the byte order of the machine that saved the file.
  */
-Board& Board::operator=(Board copy) {
-    copy.swap(*this);
-    return *this;
-}
+class BoardSnapshot {
+public:
+    BoardSnapshot() : data(nullptr), length(0), count(0), records(nullptr), heap(nullptr), heap_size(0), indexed(false) {};
+    BoardSnapshot(const BoardSnapshot&) = delete;
+    BoardSnapshot& operator=(const BoardSnapshot&) = delete;
+    ~BoardSnapshot();
+    
+    bool open(const std::string& filename);
+    void close();
+    
+    size_t size() const {return count;};
+    char type(size_t i) const;
+    int position(size_t i) const;
+    std::string a_property(size_t i) const;
+    double b_property(size_t i) const;
+    bool ParticleInPosition(int pos) const;
+    void AddTo(Board& board) const;
+    
+    friend std::ostream& operator<<(std::ostream& out, const BoardSnapshot& snapshot);
+    
+    static constexpr uint32_t VERSION = 1;
+    
+private:
+    struct Record {
+        int32_t position;
+        uint32_t type; // 'A' or 'B'
+        uint64_t payload; // bits of the B property, or heap offset in the low 32 bits and length in the high 32 bits
+    };
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t count;
+        uint64_t heap_size;
+        uint64_t reserved;
+    };
+    
+    const Record& record(size_t i) const;
+    
+    void* data; // the mapping
+    size_t length;
+    size_t count;
+    const Record* records;
+    const char* heap;
+    size_t heap_size;
+    
+    mutable PositionIndex index; // built on the first position lookup; lookups are not thread safe
+    mutable bool indexed;
+    
+    friend class Board;
+};
 
 
 
-/** Destructor for Board object
+/** @struct ParticleColumns
+ @brief Particles stored column by column instead of as separate Things on the heap. Positions, type tags and the A and B properties each live in their own contiguous array.
  */
-Board::~Board() {
-    for (const auto& x : things)
-        delete x;
-}
+struct ParticleColumns {
+    enum ParticleType : unsigned char {PARTICLE_A, PARTICLE_B};
+    
+    void push_a(int pos, std::string prop);
+    void push_b(int pos, double prop);
+    void print(std::ostream& out, size_t i) const;
+    void print(TextWriter& out, size_t i) const;
+    size_t size() const {return positions.size();};
+    
+    std::vector<int> positions;
+    std::vector<ParticleType> types;
+    std::vector<uint32_t> rows; // row of each particle in the property column of its type
+    std::vector<std::string> a_properties;
+    std::vector<double> b_properties;
+};
 
 
 
-/** Returns true if a particle has position matching input position
- @param pos is the input position
- @return true or false
+/** @class ColumnBoard
+ @brief Stores a collection of particles in ParticleColumns, so scans over positions are plain loops over ints.
  */
-bool Board::ParticleInPosition(int pos) const {
-    for (size_t i = 0; i < things.size(); ++i)
-        if (things[i]->get_position() == pos)
-            return true;
-    return false;
+class ColumnBoard {
+public:
+    ColumnBoard() {}; // default constructor
+    
+    bool ParticleInPosition(int pos) const;
+    void AddAParticle(int pos, std::string prop);
+    bool AddBParticle(int pos, double prop);
+    bool operator[](int n);
+    bool operator()();
+    
+    size_t size() const {return columns.size();};
+    const std::vector<int>& Positions() const {return columns.positions;};
+    size_t CountInPosition(int pos) const;
+    size_t CountInRange(int lo, int hi) const;
+    
+    friend std::ostream& operator<<(std::ostream& out, const ColumnBoard& board);
+private:
+    ParticleColumns columns;
+    PositionIndex index;
 };
 
 
 
-/** Adds a ThingA object to Board
- @param pos is the integer position of the ThingA
- @param prop is the string property of the ThingA
-*/
-void Board::AddAParticle(int pos, std::string prop) {
-    ThingA* thing = new ThingA(pos, prop, *this);
-    things.push_back(thing);
-}
+/** @class CowBoard
+ @brief Stores a collection of particles with copy-on-write sharing. Copying a CowBoard is O(1): both copies point at the same chunks of ParticleColumns and the same shards of the position index. The first mutation after a copy duplicates only the chunk and shard tables, the last chunk and the one index shard it touches. The shards split in two whenever they hold SHARD_POSITIONS positions on average, so the shard a mutation copies stays small however large the board grows.
+ */
+class CowBoard {
+public:
+    CowBoard() : storage(std::make_shared<Storage>()) {}; // default constructor
+    void swap(CowBoard& other);
+    
+    bool ParticleInPosition(int pos) const;
+    void AddAParticle(int pos, std::string prop);
+    bool AddBParticle(int pos, double prop);
+    bool operator[](int n);
+    bool operator()();
+    
+    size_t size() const {return storage->particles;};
+    bool SharesStorageWith(const CowBoard& other) const {return storage == other.storage;};
+    
+    friend std::ostream& operator<<(std::ostream& out, const CowBoard& board);
+private:
+    static constexpr size_t CHUNK_SIZE = 4096; // particles per chunk
+    static constexpr size_t SHARD_POSITIONS = 4096; // distinct positions per index shard, on average, before the shards split
+    
+    struct Storage {
+        Storage() : shards(1), particles(0), distinct(0) {};
+        std::vector<std::shared_ptr<ParticleColumns>> chunks; // every chunk but the last is full
+        std::vector<std::shared_ptr<PositionIndex>> shards; // a power of two of them, picked by position hash; each created on first use
+        size_t particles;
+        size_t distinct; // number of distinct positions
+    };
+    
+    Storage& writable_storage();
+    ParticleColumns& writable_tail();
+    void record_position(int pos);
+    void split_shards(Storage& table);
+    
+    std::shared_ptr<Storage> storage; // never null
+};
 
 
 
-/** Adds a ThingB object to Board
- @param pos is the integer position of the ThingB
- @param prop is the double property of the ThingB
- @return true if the particle was successfully added, false if not
+/** @struct ParticleA
+ @brief A particle with a string property, stored by value in a VariantBoard
+ */
+struct ParticleA {
+    int position;
+    std::string property;
+};
+
+
+
+/** @struct ParticleB
+ @brief A particle with a double property, stored by value in a VariantBoard
+ */
+struct ParticleB {
+    int position;
+    double property;
+};
+
+
+
+/** @class VariantBoard
+ @brief Stores a collection of particles by value as a closed variant of ParticleA and ParticleB instead of as Things behind pointers. Operations dispatch with std::visit over the two known types, so the compiler can inline them; copying the board is a plain vector copy.
+ */
+class VariantBoard {
+public:
+    typedef std::variant<ParticleA, ParticleB> Particle;
+    
+    VariantBoard() {}; // default constructor
+    
+    bool ParticleInPosition(int pos) const;
+    void AddAParticle(int pos, std::string prop);
+    bool AddBParticle(int pos, double prop);
+    bool operator[](int n);
+    bool operator()();
+    
+    size_t size() const {return particles.size();};
+    std::vector<int> Positions() const;
+    size_t CountInPosition(int pos) const;
+    
+    friend std::ostream& operator<<(std::ostream& out, const VariantBoard& board);
+private:
+    std::vector<Particle> particles;
+    PositionIndex index;
+};
+
+
+
+#ifdef BOARD_BENCHMARK
+void benchmark_position_lookup(int n);
+void benchmark_collisions(int n);
+void benchmark_column_scan(int n);
+void benchmark_copy(int n);
+void benchmark_snapshots(int n);
+void benchmark_batch_ingestion(int n);
+void benchmark_snapshot_load(int n);
+void benchmark_text_export(int n);
+void benchmark_board_container(int n);
+void benchmark_simulation(int n, unsigned n_threads);
+void benchmark_variant_board(int n);
+void benchmark_removal(int n);
+
+int main() {
+    for (int n = 1000; n <= 16000; n *= 2)
+        benchmark_position_lookup(n);
+    for (int n = 1 << 16; n <= 1 << 22; n *= 4)
+        benchmark_collisions(n);
+    for (int n = 1 << 16; n <= 1 << 20; n *= 4)
+        benchmark_column_scan(n);
+    for (int n = 1 << 14; n <= 1 << 20; n *= 4)
+        benchmark_copy(n);
+    for (int n = 1 << 14; n <= 1 << 18; n *= 4)
+        benchmark_snapshots(n);
+    for (int n = 1 << 16; n <= 1 << 22; n *= 4)
+        benchmark_batch_ingestion(n);
+    for (int n = 1 << 16; n <= 1 << 22; n *= 4)
+        benchmark_snapshot_load(n);
+    for (int n = 1 << 16; n <= 1 << 20; n *= 4)
+        benchmark_text_export(n);
+    for (int n = 64; n <= 1024; n *= 4)
+        benchmark_board_container(n);
+    for (unsigned t = 1; t <= std::max(4u, std::thread::hardware_concurrency()); t *= 2)
+        benchmark_simulation(1 << 20, t);
+    for (int n = 1 << 16; n <= 1 << 20; n *= 4)
+        benchmark_variant_board(n);
+    for (int n = 1 << 14; n <= 1 << 20; n *= 4)
+        benchmark_removal(n);
+    return 0;
+}
+#else
+int main() {
+    {
+        Board Z;
+        Z.AddAParticle(0, "red");
+        Z.AddBParticle(9, 2.71828);
+        
+        Board Y(Z);
+        
+        Y.AddAParticle(2, "green");
+        
+        Y = Z;
+    }
+    
+#ifdef BOARD_TRACE
+    LifecycleTrace::dump("hw1_lifecycle.trace"); // every Thing has been destroyed by now
+#endif
+    
+    return 0;
+}
+#endif
+
+
+
+/** Hands out a unique ID without contention. Each thread claims a block of ID_BLOCK IDs from the shared counter and uses it up before claiming another, so IDs stay unique across threads and Boards.
+ @return the ID
+ */
+int Thing::next_id() {
+    thread_local int next = 0;
+    thread_local int end = 0;
+    
+    if (next == end) {
+        next = IDgen.fetch_add(ID_BLOCK, std::memory_order_relaxed) + 1;
+        end = next + ID_BLOCK;
+    }
+    return next++;
+}
+
+
+
+/** Records one lifecycle event. Claims the next sequence number atomically, so concurrent callers never wait on each other.
+ @param event is what happened to the Thing
+ @param kind is the type of the Thing
+ @param id is the ID of the Thing
+ */
+void LifecycleTrace::record(Event event, Kind kind, int id) {
+    uint64_t sequence = next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = ring[sequence & (CAPACITY - 1)];
+    
+    slot.stamp.store(0, std::memory_order_relaxed); // marks the slot as being written
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.payload.store(static_cast<uint32_t>(id) | (static_cast<uint64_t>(event) << 32) | (static_cast<uint64_t>(kind) << 40), std::memory_order_relaxed);
+    slot.stamp.store(sequence + 1, std::memory_order_release);
+}
+
+
+
+/** Writes the events still in the ring to a binary file. The file holds the magic "THTR", a format version byte, the sequence number of the first event and the event count as little-endian 64-bit integers, then 6 bytes per event: the 32-bit ID, the event and the kind. Slots that are being overwritten while dumping are skipped.
+ @param filename is the name of the file
+ @return true if the file was written, false if not
+ */
+bool LifecycleTrace::dump(const std::string& filename) {
+    
+    uint64_t end = next.load(std::memory_order_acquire);
+    uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+    
+    std::vector<unsigned char> events;
+    events.reserve(6 * (end - begin));
+    uint64_t count = 0;
+    for (uint64_t sequence = begin; sequence < end; ++sequence) {
+        const Slot& slot = ring[sequence & (CAPACITY - 1)];
+        uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+        uint64_t payload = slot.payload.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (stamp != sequence + 1 || slot.stamp.load(std::memory_order_relaxed) != stamp)
+            continue;
+        
+        for (int i = 0; i < 6; ++i)
+            events.push_back(static_cast<unsigned char>(payload >> (8 * i)));
+        ++count;
+    }
+    
+    std::ofstream fout(filename, std::ios::binary);
+    if (!fout) return false;
+    
+    unsigned char header[21] = {'T', 'H', 'T', 'R', 1};
+    for (int i = 0; i < 8; ++i) {
+        header[5 + i] = static_cast<unsigned char>(begin >> (8 * i));
+        header[13 + i] = static_cast<unsigned char>(count >> (8 * i));
+    }
+    fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+    fout.write(reinterpret_cast<const char*>(events.data()), events.size());
+    return static_cast<bool>(fout);
+}
+
+
+
+/** Constructor for ThingA object
+ @param pos is the position 
+ @param prop is the string property
+ @param b is the Board on which the ThingA is located
+ */
+ThingA::ThingA(int pos, std::string prop, const Board& b) : Thing(pos, b), property(prop) {
+    ID = next_id(); // creates unique ID
+    TracePolicy::record(LifecycleTrace::CONSTRUCT, LifecycleTrace::THING_A, ID); // records construction
+};
+
+
+
+/** Copy constructor for ThingA object
+ @param thing whose values will be used to initialize object
+ */
+ThingA::ThingA(const ThingA& thing) : Thing(thing), property(thing.property) {
+    ID = next_id(); // creates unique ID
+    TracePolicy::record(LifecycleTrace::COPY, LifecycleTrace::THING_A, ID); // records construction
+}
+
+
+
+/** Destructor for ThingA object
+ */
+ThingA::~ThingA() {
+    TracePolicy::record(LifecycleTrace::DESTRUCT, LifecycleTrace::THING_A, ID); // records destruction
+}
+
+
+
+/** Constructor for ThingB object
+ @param pos is the position
+ @param prop is the double property
+ @param b is the Board on which the ThingB is located
+ */
+ThingB::ThingB(int pos, double prop, const Board& b) : Thing(pos, b), property(prop) {
+    ID = next_id(); // creates unique ID
+    TracePolicy::record(LifecycleTrace::CONSTRUCT, LifecycleTrace::THING_B, ID); // records construction
+};
+
+
+
+/** Copy constructor for ThingB object
+ @param thing whose values will be used to initialize object
+ */
+ThingB::ThingB(const ThingB& thing) : Thing(thing), property(thing.property) {
+    ID = next_id(); // creates unique ID
+    TracePolicy::record(LifecycleTrace::COPY, LifecycleTrace::THING_B, ID); // records construction
+}
+
+
+
+/** Destructor for ThingB object
+ */
+ThingB::~ThingB() {
+    TracePolicy::record(LifecycleTrace::DESTRUCT, LifecycleTrace::THING_B, ID); // records destruction
+}
+
+
+
+/** Prints out the type, position, and property of a ThingA object
+ @param out is the output stream
+ */
+void ThingA::print(std::ostream& out) const {
+    out << "A:" << get_position() << ":" << property;
+}
+
+
+
+/** Writes the type, position, and property of a ThingA object into a TextWriter, in the same format as print(std::ostream&)
+ @param out is the writer
+ */
+void ThingA::print(TextWriter& out) const {
+    out.write("A:", 2);
+    out.write(get_position());
+    out.write(':');
+    out.write(property);
+}
+
+
+
+/** Prints out the type, position, and property of a ThingB object
+ @param out is the output stream
+ */
+void ThingB::print(std::ostream& out) const {
+    out << "B:" << get_position() << ":" << property;
+}
+
+
+
+/** Writes the type, position, and property of a ThingB object into a TextWriter, in the same format as print(std::ostream&)
+ @param out is the writer
+ */
+void ThingB::print(TextWriter& out) const {
+    out.write("B:", 2);
+    out.write(get_position());
+    out.write(':');
+    out.write(property);
+}
+
+
+
+/** Creates a clone of ThingA object on the heap
+ @return a pointer to the clone
+ */
+ThingA* ThingA::clone() const {
+    
+    ThingA* thing = nullptr;
+    try {
+        thing = new ThingA (*this); // try allocating memory on heap
+    }
+    catch (std::exception& e) {
+        std::cerr << "Failure at ThingA::clone()" << std::endl;
+        thing = nullptr;
+    }
+    return thing;
+}
+
+
+
+/** Creates a clone of ThingA object in a pool
+ @param pool is the pool that provides the memory
+ @return a pointer to the clone
+ */
+ThingA* ThingA::clone(ThingPool& pool) const {
+    return new (pool.allocate(sizeof(ThingA))) ThingA(*this);
+}
+
+
+
+/** Creates a clone of ThingB object on the heap
+ @return a pointer to the clone
+ */
+ThingB* ThingB::clone() const {
+    
+    ThingB* thing = nullptr;
+    try {
+        thing = new ThingB (*this); // try allocating memory on heap
+    }
+    catch (std::exception& e) {
+        std::cerr << "Failure at ThingB::clone()" << std::endl;
+        thing = nullptr;
+    }
+    return thing;
+}
+
+
+
+/** Creates a clone of ThingB object in a pool
+ @param pool is the pool that provides the memory
+ @return a pointer to the clone
+ */
+ThingB* ThingB::clone(ThingPool& pool) const {
+    return new (pool.allocate(sizeof(ThingB))) ThingB(*this);
+}
+
+
+
+/** Copy constructor for Board object
+ @param copy is the Board used to initialize object
+ */
+Board::Board(const Board& copy) {
+    
+    // one block holds every clone, so the copy costs a single allocation
+    size_t n = copy.things.size();
+    things.reserve(n);
+    pool.reserve(copy.pool.bytes_used());
+    
+    try {
+        const BoardLink* own = copy.things.empty() ? nullptr : shared_link();
+        for (size_t i = 0; i < n; ++i) {
+            Thing* thing = copy.things[i]->clone(pool);
+            thing->link = own; // the clone belongs to this Board, not the original
+            things.push_back(thing);
+        }
+        copy_indexes(copy);
+    }
+    catch (std::exception& e) {
+        std::cerr << "Failure at Board::Board(const Board&)" << std::endl;
+        for (const auto& x : things)
+            x->~Thing();
+        throw;
+    }
+}
+
+
+
+/** Move constructor for Board object. Takes over the particles, pool and index of another Board without copying them; only the link the particles point to is updated.
+ @param other is the Board to be moved from, left empty
+ */
+Board::Board(Board&& other) noexcept : link(std::move(other.link)) {
+    things.swap(other.things);
+    pool.swap(other.pool);
+    index.swap(other.index);
+    ordered.swap(other.ordered);
+    ids.swap(other.ids);
+    next_here.swap(other.next_here);
+    prev_here.swap(other.prev_here);
+    if (link) link->board = this;
+}
+
+
+
+/** Swaps two Boards. The links are swapped along with the particles that point to them and then told where their Board now lives.
+ @param other is the board to be swapped with
+ */
+void Board::swap(Board& other) noexcept {
+    std::swap(things, other.things);
+    pool.swap(other.pool);
+    index.swap(other.index);
+    ordered.swap(other.ordered);
+    ids.swap(other.ids);
+    next_here.swap(other.next_here);
+    prev_here.swap(other.prev_here);
+    link.swap(other.link);
+    if (link) link->board = this;
+    if (other.link) other.link->board = &other;
+}
+
+
+
+/** Builds the indexes for clones of the particles of another Board. Each clone keeps the slot of its original, so the position-keyed indexes and chains carry over as they are; only the IDs are new.
+ @param copy is the Board whose particles were cloned into things, slot for slot
+ */
+void Board::copy_indexes(const Board& copy) {
+    index = copy.index;
+    next_here = copy.next_here;
+    prev_here = copy.prev_here;
+    
+    ids.reserve(things.size());
+    for (uint32_t i = 0, n = static_cast<uint32_t>(things.size()); i < n; ++i)
+        ids.assign(things[i]->get_id(), i);
+    
+    ordered = copy.ordered;
+    ordered.rename([&](int id) {
+        uint32_t slot = copy.ids.find(id);
+        return slot == SlotIndex::NONE ? id : things[slot]->get_id();
+    });
+}
+
+
+
+/** Returns the link that this Board's particles point to, creating it on first use
+ @return the link
+ */
+const BoardLink* Board::shared_link() const {
+    if (!link)
+        link.reset(new BoardLink{this});
+    return link.get();
+}
+
+
+
+/** Appends a constructed particle to the Board and records it in every index
+ @param thing is the particle, allocated from the Board's pool
+ */
+void Board::adopt(Thing* thing) {
+    int pos = thing->get_position();
+    uint32_t slot = static_cast<uint32_t>(things.size());
+    
+    things.push_back(thing);
+    next_here.push_back(SlotIndex::NONE);
+    prev_here.push_back(SlotIndex::NONE);
+    uint32_t head = index.insert(pos, slot); // one probe both counts the particle and heads its chain with it
+    next_here[slot] = head;
+    if (head != SlotIndex::NONE) prev_here[head] = slot;
+    ids.assign(thing->get_id(), slot);
+    ordered.insert(pos, thing->get_id());
+}
+
+
+
+/** Drops the particle in a slot from every index and from the chain of its position. The slot itself is left in place.
+ @param slot is the slot of the particle
+ */
+void Board::unlink(size_t slot) {
+    const Thing* thing = things[slot];
+    int pos = thing->get_position();
+    uint32_t prev = prev_here[slot], next = next_here[slot];
+    
+    if (prev != SlotIndex::NONE) next_here[prev] = next;
+    else if (next != SlotIndex::NONE) index.set_head(pos, next);
+    if (next != SlotIndex::NONE) prev_here[next] = prev;
+    
+    index.erase(pos); // drops the head along with the position once its last particle goes
+    ordered.erase(pos, thing->get_id());
+    ids.erase(thing->get_id());
+}
+
+
+
+/** Runs the destructor of a particle and gives its memory back to the pool
+ @param thing is the particle
+ */
+void Board::destroy(Thing* thing) {
+    size_t size = thing->get_type() == 'A' ? sizeof(ThingA) : sizeof(ThingB);
+    thing->~Thing();
+    pool.deallocate(thing, size);
+}
+
+
+
+/** Removes the particle in a slot by moving the last particle into its place, so no other slot changes
+ @param slot is the slot of the particle
+ */
+void Board::remove_slot(size_t slot) {
+    unlink(slot);
+    destroy(things[slot]);
+    
+    size_t last = things.size() - 1;
+    if (slot != last) {
+        const Thing* moved = things[last];
+        uint32_t prev = prev_here[last], next = next_here[last];
+        things[slot] = things[last];
+        prev_here[slot] = prev;
+        next_here[slot] = next;
+        
+        if (prev != SlotIndex::NONE) next_here[prev] = static_cast<uint32_t>(slot);
+        else index.set_head(moved->get_position(), static_cast<uint32_t>(slot));
+        if (next != SlotIndex::NONE) prev_here[next] = static_cast<uint32_t>(slot);
+        ids.assign(moved->get_id(), static_cast<uint32_t>(slot));
+    }
+    things.pop_back();
+    prev_here.pop_back();
+    next_here.pop_back();
+}
+
+
+
+/** Rebuilds the chains that link the particles sharing a position
+ */
+void Board::rechain() {
+    index.clear_heads();
+    next_here.assign(things.size(), SlotIndex::NONE);
+    prev_here.assign(things.size(), SlotIndex::NONE);
+    
+    for (uint32_t i = 0, n = static_cast<uint32_t>(things.size()); i < n; ++i) {
+        int pos = things[i]->get_position();
+        uint32_t head = index.head(pos);
+        next_here[i] = head;
+        if (head != SlotIndex::NONE) prev_here[head] = i;
+        index.set_head(pos, i);
+    }
+}
+
+
+
+/** Moves every particle to a new position and rebuilds the position indexes
+ @param positions holds the new position of each particle, by slot
+ */
+void Board::relocate(const std::vector<int>& positions) {
+    if (positions.size() != things.size())
+        throw std::logic_error("Board::relocate: one position per particle expected");
+    
+    PositionIndex new_index;
+    RangeIndex new_ordered;
+    new_index.reserve(things.size());
+    new_ordered.reserve(things.size());
+    for (size_t i = 0, n = things.size(); i < n; ++i) {
+        things[i]->position = positions[i];
+        new_index.insert(positions[i]);
+        new_ordered.insert(positions[i], things[i]->get_id());
+    }
+    index.swap(new_index);
+    ordered.swap(new_ordered);
+    rechain();
+}
+
+
+
+/** Constructor for Thing object
+ @param pos is the position
+ @param b is the Board on which the Thing is located
+ */
+Thing::Thing(int pos, const Board& b) : position(pos), link(b.shared_link()) {}
+
+
+
+/** Overloaded operator= for Board
+ @param copy is the Board object to be set equal to
+ @return the Board object
+ */
+Board& Board::operator=(Board copy) noexcept {
+    copy.swap(*this);
+    return *this;
+}
+
+
+
+/** Destructor for Board object
+ */
+Board::~Board() {
+    // the pool releases the memory in bulk, so only the destructors run here
+    for (const auto& x : things)
+        x->~Thing();
+}
+
+
+
+/** Returns true if a particle has position matching input position
+ @param pos is the input position
+ @return true or false
+ */
+bool Board::ParticleInPosition(int pos) const {
+    return index.count(pos) > 0;
+};
+
+
+
+/** Adds a ThingA object to Board
+ @param pos is the integer position of the ThingA
+ @param prop is the string property of the ThingA
+*/
+void Board::AddAParticle(int pos, std::string prop) {
+    adopt(new (pool.allocate(sizeof(ThingA))) ThingA(pos, prop, *this));
+}
+
+
+
+/** Adds a ThingB object to Board
+ @param pos is the integer position of the ThingB
+ @param prop is the double property of the ThingB
+ @return true if the particle was successfully added, false if not
  */
 bool Board::AddBParticle(int pos, double prop) {
     
-    // If no particle is at position pos, then add, otherwise don't add.
-    if (!ParticleInPosition(pos)) {
-        ThingB* thing = new ThingB(pos, prop, *this);
-        things.push_back(thing);
-        return true;
+    // If no particle is at position pos, then add, otherwise don't add.
+    if (!ParticleInPosition(pos)) {
+        adopt(new (pool.allocate(sizeof(ThingB))) ThingB(pos, prop, *this));
+        return true;
+    }
+    return false;
+}
+
+
+
+/** Removes every particle at a position. Each removal fills its slot with the last particle of the Board, so the cost does not depend on how many particles the Board holds.
+ @param pos is the position
+ @return the number of particles removed
+ */
+size_t Board::RemoveParticlesAt(int pos) {
+    size_t removed = 0;
+    for (uint32_t slot = index.head(pos); slot != SlotIndex::NONE; slot = index.head(pos)) {
+        remove_slot(slot);
+        ++removed;
+    }
+    return removed;
+}
+
+
+
+/** Removes the particle with a given ID, filling its slot with the last particle of the Board
+ @param id is the ID of the particle
+ @return true if the particle was on the Board, false if not
+ */
+bool Board::RemoveParticle(int id) {
+    uint32_t slot = ids.find(id);
+    if (slot == SlotIndex::NONE) return false;
+    remove_slot(slot);
+    return true;
+}
+
+
+
+/** Removes every particle a predicate holds for. The predicate is asked about every particle first, so the Board is left unchanged if it throws; the survivors are then slid down in one pass that keeps their order.
+ @param pred is the predicate
+ @return the number of particles removed
+ */
+size_t Board::RemoveParticlesIf(const std::function<bool(const Thing&)>& pred) {
+    std::vector<bool> doomed(things.size());
+    size_t removed = 0;
+    for (size_t i = 0, n = things.size(); i < n; ++i)
+        if ((doomed[i] = pred(*things[i]))) ++removed;
+    if (removed == 0) return 0;
+    
+    size_t kept = 0;
+    for (size_t i = 0, n = things.size(); i < n; ++i) {
+        Thing* thing = things[i];
+        if (doomed[i]) {
+            index.erase(thing->get_position());
+            ordered.erase(thing->get_position(), thing->get_id());
+            ids.erase(thing->get_id());
+            destroy(thing);
+            continue;
+        }
+        if (kept != i) ids.assign(thing->get_id(), static_cast<uint32_t>(kept));
+        things[kept++] = thing;
+    }
+    things.resize(kept);
+    rechain();
+    return removed;
+}
+
+
+
+/** Adds a batch of ThingA objects to Board, reserving room for all of them at once
+ @param records are the positions and properties of the ThingAs
+ */
+void Board::AddAParticles(const std::vector<ARecord>& records) {
+    things.reserve(things.size() + records.size());
+    pool.reserve(records.size(), sizeof(ThingA));
+    index.reserve(index.size() + records.size());
+    ordered.reserve(things.size() + records.size());
+    ids.reserve(things.size() + records.size());
+    
+    for (const auto& x : records)
+        adopt(new (pool.allocate(sizeof(ThingA))) ThingA(x.position, x.property, *this));
+}
+
+
+
+/** Adds a batch of ThingB objects to Board in one pass over the records. A record is rejected if its position is taken, either on the Board or by an earlier record of the batch; the same probe that checks the position records it. Every accepted particle is alone at its position, so its chain is just itself, and the range index is settled once at the end.
+ @param records are the positions and properties of the ThingBs
+ @return the indices of the rejected records, in increasing order
+ */
+std::vector<size_t> Board::AddBParticles(const std::vector<BRecord>& records) {
+    size_t total = things.size() + records.size();
+    things.reserve(total);
+    pool.reserve(records.size(), sizeof(ThingB));
+    index.reserve(index.size() + records.size());
+    ordered.reserve(total);
+    ids.reserve(total);
+    next_here.reserve(total);
+    prev_here.reserve(total);
+    
+    // nothing below reallocates, so a record is either taken in full or not at all
+    std::vector<size_t> rejected;
+    for (size_t i = 0, n = records.size(); i < n; ++i) {
+        int pos = records[i].position;
+        uint32_t slot = static_cast<uint32_t>(things.size());
+        if (!index.insert_new(pos, slot)) {
+            rejected.push_back(i);
+            continue;
+        }
+        Thing* thing = new (pool.allocate(sizeof(ThingB))) ThingB(pos, records[i].property, *this);
+        things.push_back(thing);
+        ids.assign(thing->get_id(), slot);
+        ordered.insert(pos, thing->get_id());
+    }
+    next_here.resize(things.size(), SlotIndex::NONE);
+    prev_here.resize(things.size(), SlotIndex::NONE);
+    ordered.settle();
+    return rejected;
+}
+
+
+
+/** Saves the Board as a binary snapshot that BoardSnapshot can map back in. Writes the header, the records and then the string heap in one streaming pass each.
+ @param filename is the name of the file
+ @return true if the file was written, false if not; nothing is written if the string heap would not fit the 32-bit offsets
+ */
+bool Board::SaveSnapshot(const std::string& filename) const {
+    
+    // the records hold 32-bit heap offsets, so an oversized heap is rejected before the file is touched
+    uint64_t heap_size = 0;
+    for (const auto& x : things)
+        if (x->get_type() == 'A')
+            heap_size += static_cast<const ThingA*>(x)->get_property().size();
+    if (heap_size > UINT32_MAX) {
+        std::cerr << "Failure at Board::SaveSnapshot(): string heap over 4 GiB" << std::endl;
+        return false;
+    }
+    
+    std::ofstream fout(filename, std::ios::binary);
+    if (!fout) return false;
+    
+    BoardSnapshot::Header header = {{'B', 'R', 'D', 'S'}, BoardSnapshot::VERSION, things.size(), heap_size, 0};
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    std::vector<BoardSnapshot::Record> buffer;
+    buffer.reserve(4096);
+    uint64_t offset = 0;
+    for (size_t i = 0, n = things.size(); i < n; ++i) {
+        
+        BoardSnapshot::Record record = {things[i]->get_position(), static_cast<uint32_t>(things[i]->get_type()), 0};
+        if (record.type == 'A') {
+            uint64_t bytes = static_cast<const ThingA*>(things[i])->get_property().size();
+            record.payload = offset | (bytes << 32);
+            offset += bytes;
+        }
+        else {
+            double prop = static_cast<const ThingB*>(things[i])->get_property();
+            std::memcpy(&record.payload, &prop, sizeof(prop));
+        }
+        
+        buffer.push_back(record);
+        if (buffer.size() == buffer.capacity() || i + 1 == n) {
+            fout.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(BoardSnapshot::Record));
+            buffer.clear();
+        }
+    }
+    
+    for (const auto& x : things)
+        if (x->get_type() == 'A') {
+            const std::string& prop = static_cast<const ThingA*>(x)->get_property();
+            fout.write(prop.data(), prop.size());
+        }
+    
+    return static_cast<bool>(fout);
+}
+
+
+
+/** Fills the Board from several producer threads at once. Every producer runs on its own thread and adds particles to its own ParticleSink; the sinks are then merged in producer order, so the result matches calling each producer's adds one after another. A B particle whose position is taken by then is dropped, as in AddBParticle.
+ @param producers are the functions that add particles
+ @return the number of B particles dropped
+ */
+size_t Board::AddParticlesConcurrently(const std::vector<std::function<void(ParticleSink&)>>& producers) {
+    
+    shared_link(); // created up front, since the producers' Things all read it
+    
+    std::vector<std::unique_ptr<ParticleSink>> sinks;
+    for (size_t i = 0; i < producers.size(); ++i)
+        sinks.emplace_back(new ParticleSink(*this));
+    
+    std::vector<std::exception_ptr> errors(producers.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < producers.size(); ++i) {
+        workers.emplace_back([&, i]() {
+            try {
+                producers[i](*sinks[i]);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& x : workers)
+        x.join();
+    
+    for (const auto& x : errors)
+        if (x) std::rethrow_exception(x); // the sinks destroy what they made
+    
+    size_t total = things.size();
+    for (const auto& x : sinks)
+        total += x->things.size();
+    things.reserve(total);
+    index.reserve(total);
+    ordered.reserve(total);
+    ids.reserve(total);
+    
+    size_t dropped = 0;
+    for (const auto& sink : sinks) {
+        for (size_t i = 0, n = sink->things.size(); i < n; ++i) {
+            Thing* thing = sink->things[i];
+            int pos = thing->get_position();
+            
+            if (sink->exclusive[i] && ParticleInPosition(pos)) {
+                thing->~Thing();
+                sink->pool.deallocate(thing, sizeof(ThingB)); // free for reuse once absorbed, not counted as used
+                ++dropped;
+                continue;
+            }
+            adopt(thing);
+        }
+        sink->things.clear();
+        pool.absorb(sink->pool);
+    }
+    return dropped;
+}
+
+
+
+/** Destructor for ParticleSink object. Destroys the particles that were never merged into the Board.
+ */
+ParticleSink::~ParticleSink() {
+    for (const auto& x : things)
+        x->~Thing();
+}
+
+
+
+/** Makes room for one more particle in both vectors, doubling their capacity when full, so the pushes that follow cannot throw and leave a Thing without its flag
+ */
+void ParticleSink::make_room() {
+    if (things.size() == things.capacity())
+        things.reserve(2 * things.size() + 16);
+    if (exclusive.capacity() < things.capacity())
+        exclusive.reserve(things.capacity());
+}
+
+
+
+/** Adds a ThingA object to the sink
+ @param pos is the integer position of the ThingA
+ @param prop is the string property of the ThingA
+ */
+void ParticleSink::AddAParticle(int pos, std::string prop) {
+    make_room();
+    things.push_back(new (pool.allocate(sizeof(ThingA))) ThingA(pos, std::move(prop), board));
+    exclusive.push_back(false);
+}
+
+
+
+/** Adds a ThingB object to the sink
+ @param pos is the integer position of the ThingB
+ @param prop is the double property of the ThingB
+ */
+void ParticleSink::AddBParticle(int pos, double prop) {
+    make_room();
+    things.push_back(new (pool.allocate(sizeof(ThingB))) ThingB(pos, prop, board));
+    exclusive.push_back(true);
+}
+
+
+
+/** Overloads operator<< for Board object
+ @param out is the stream object with which to output
+ @param board is the Board object
+ @return the stream object
+ */
+std::ostream& operator<<(std::ostream& out, const Board& board) {
+    if (!TextWriter::formats_like(out)) {
+        for (const auto& x : board.things) {
+            x->print(out);
+            out << '\n';
+        }
+        return out;
+    }
+    
+    TextWriter writer(out);
+    for (const auto& x : board.things) {
+        x->print(writer);
+        writer.write('\n');
+    }
+    writer.flush();
+    return out;
+}
+
+
+
+/** Writes the same lines as operator<< straight to a file descriptor, bypassing iostreams
+ @param fd is the file descriptor
+ @return true if every byte was written, false if not
+ */
+bool Board::Export(int fd) const {
+    TextWriter writer(fd);
+    for (const auto& x : things) {
+        x->print(writer);
+        writer.write('\n');
+    }
+    return writer.flush();
+}
+
+
+
+/** Overloads operator[] for Board object so that it returns true if any particles on the board have position equal to the input value
+ @param n is the input value
+ @return a bool
+ */
+bool Board::operator[](int n) {
+    return ParticleInPosition(n);
+}
+
+
+
+/** Overloads operator() for Board object so that it returns true if any particles in Board share the same position
+ @return a bool
+ */
+bool Board::operator()() {
+    if (things.size() == 1) return true; // if Board stores only one particle
+    
+    // every particle has its own position exactly when the index holds one entry per particle
+    return index.size() < things.size();
+}
+
+
+
+/** Copies the particle positions into a contiguous array, in the order the particles were added
+ @return the positions
+ */
+std::vector<int> Board::Positions() const {
+    std::vector<int> positions;
+    positions.reserve(things.size());
+    for (const auto& x : things)
+        positions.push_back(x->get_position());
+    return positions;
+}
+
+
+
+/** Lists every position shared by more than one particle
+ @param n_threads is the number of threads used for the search
+ @return the groups of colliding particles, ordered by position
+ */
+std::vector<CollisionGroup> Board::Collisions(unsigned n_threads) const {
+    return CollisionDetector(n_threads).groups(Positions());
+}
+
+
+
+/** Counts the particles with positions in [lo, hi]
+ @param lo is the lowest position counted
+ @param hi is the highest position counted
+ @return the number of particles
+ */
+size_t Board::CountInRange(int lo, int hi) const {
+    return ordered.count(lo, hi);
+}
+
+
+
+/** Lists the particles with positions in [lo, hi]
+ @param lo is the lowest position listed
+ @param hi is the highest position listed
+ @return the particles, ordered by position and then by ID
+ */
+std::vector<const Thing*> Board::ParticlesInRange(int lo, int hi) const {
+    std::vector<const Thing*> found;
+    for (const auto& x : ordered.find(lo, hi))
+        found.push_back(things[ids.find(x)]);
+    return found;
+}
+
+
+
+/** Returns true if any two entries of a position array are equal. Stops at the first repeat when searching serially.
+ @param positions is the array of positions
+ @return a bool
+ */
+bool CollisionDetector::any(const std::vector<int>& positions) const {
+    if (threads > 1)
+        return !groups(positions).empty();
+    
+    PositionIndex seen;
+    seen.reserve(positions.size());
+    for (const auto& x : positions) {
+        if (seen.count(x) > 0)
+            return true;
+        seen.insert(x);
+    }
+    return false;
+}
+
+
+
+/** Finds every position that appears more than once in a position array, on threads started for the call
+ @param positions is the array of positions
+ @return the groups of slots sharing a position, ordered by position
+ */
+std::vector<CollisionGroup> CollisionDetector::groups(const std::vector<int>& positions) const {
+    return groups(positions, [this](const std::function<void(unsigned)>& task) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(task, t);
+        for (auto& x : workers)
+            x.join();
+    });
+}
+
+
+
+/** Finds every position that appears more than once in a position array, with the threads of a caller-supplied runner
+ @param positions is the array of positions
+ @param run runs each pass of the search on the caller's threads
+ @return the groups of slots sharing a position, ordered by position
+ */
+std::vector<CollisionGroup> CollisionDetector::groups(const std::vector<int>& positions, const Runner& run) const {
+    
+    std::vector<CollisionGroup> result;
+    size_t n = positions.size();
+    
+    // splitting is not worth a thread start-up for small arrays
+    if (threads == 1 || n < 4096) {
+        std::vector<size_t> slots(n);
+        for (size_t i = 0; i < n; ++i)
+            slots[i] = i;
+        find_in_partition(positions, slots, result);
+        return result;
+    }
+    
+    // each thread scatters its chunk of slots into one bucket per partition; equal positions always land in the same partition
+    std::vector<std::vector<std::vector<size_t>>> buckets(threads, std::vector<std::vector<size_t>>(threads));
+    run([&](unsigned t) {
+        for (size_t i = n * t / threads, end = n * (t + 1) / threads; i < end; ++i) {
+            buckets[t][mix_position(positions[i]) % threads].push_back(i);
+        }
+    });
+    
+    // each thread then gathers one partition from every bucket and searches it
+    std::vector<std::vector<CollisionGroup>> found(threads);
+    run([&](unsigned p) {
+        std::vector<size_t> slots;
+        for (unsigned t = 0; t < threads; ++t)
+            slots.insert(slots.end(), buckets[t][p].begin(), buckets[t][p].end());
+        find_in_partition(positions, slots, found[p]);
+    });
+    
+    for (auto& x : found)
+        for (auto& group : x)
+            result.push_back(std::move(group));
+    std::sort(result.begin(), result.end(), [](const CollisionGroup& lhs, const CollisionGroup& rhs) {return lhs.position < rhs.position;});
+    return result;
+}
+
+
+
+/** Finds the repeated positions among a subset of slots. Counts every position in a hash index, then sorts only the slots whose position repeats.
+ @param positions is the array of positions
+ @param slots is the subset of slots to search, in increasing order
+ @param out is where the groups found are appended, ordered by position
+ */
+void CollisionDetector::find_in_partition(const std::vector<int>& positions, const std::vector<size_t>& slots, std::vector<CollisionGroup>& out) const {
+    
+    PositionIndex counts;
+    counts.reserve(slots.size());
+    for (const auto& x : slots)
+        counts.insert(positions[x]);
+    if (counts.size() == slots.size()) return; // no repeats
+    
+    std::vector<std::pair<int, size_t>> shared;
+    for (const auto& x : slots)
+        if (counts.count(positions[x]) > 1)
+            shared.emplace_back(positions[x], x);
+    std::sort(shared.begin(), shared.end());
+    
+    for (size_t i = 0; i < shared.size(); ++i) {
+        if (i == 0 || shared[i].first != shared[i-1].first)
+            out.push_back(CollisionGroup{shared[i].first, {}});
+        out.back().slots.push_back(shared[i].second);
+    }
+}
+
+
+
+/** Constructor for Simulation object. Copies the particle positions out of the Board and starts the worker threads.
+ @param b is the Board whose particles are simulated
+ @param update_rule is the rule that computes every tick's positions
+ @param n_threads is the number of threads that apply the rule
+ */
+Simulation::Simulation(Board& b, UpdateRule update_rule, unsigned n_threads) : board(b), rule(update_rule), threads(n_threads == 0 ? 1 : n_threads), current(b.Positions()), next(current.size()), ticks_done(0), occupancy(threads), check(threads), undone(threads), task(nullptr), generation(0), running(0), stopping(false) {
+    
+    exclusive.reserve(current.size());
+    for (const auto& x : b.things)
+        exclusive.push_back(x->get_type() == 'B');
+    
+    for (unsigned t = 1; t < threads; ++t) // the calling thread works chunk 0
+        workers.emplace_back(&Simulation::work, this, t);
+}
+
+
+
+/** Destructor for Simulation object. Stops the worker threads; the Board keeps the positions of the last sync().
+ */
+Simulation::~Simulation() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_pass.notify_all();
+    for (auto& x : workers)
+        x.join();
+}
+
+
+
+/** Loop of a worker thread: waits for a new pass, runs the pass's task with its number, and reports back. An exception from the task is kept for run_pass to rethrow instead of ending the thread.
+ @param t is the number of the worker
+ */
+void Simulation::work(unsigned t) {
+    uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(unsigned)>* pass_task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_pass.wait(lock, [&]() {return stopping || generation != seen;});
+            if (stopping) return;
+            seen = generation;
+            pass_task = task;
+        }
+        
+        std::exception_ptr error;
+        try {
+            (*pass_task)(t);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error && !failure)
+            failure = error;
+        if (--running == 0)
+            end_pass.notify_one();
+    }
+}
+
+
+
+/** Runs a task on every thread of the simulation at once, the calling thread taking number 0, and waits until all are done
+ @param task is called with each thread's number, from 0 to threads - 1
+ @throws the first exception any of the calls threw, once every call has finished
+ */
+void Simulation::run_pass(const std::function<void(unsigned)>& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = threads - 1;
+        this->task = &task;
+        ++generation;
+    }
+    start_pass.notify_all();
+    
+    std::exception_ptr error;
+    try {
+        task(0);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        end_pass.wait(lock, [&]() {return running == 0;});
+        if (!error)
+            error = failure;
+        failure = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+
+
+/** Applies the rule to every chunk, one chunk per thread, and waits until all chunks are done
+ */
+void Simulation::run_chunks() {
+    run_pass([this](unsigned t) {
+        size_t n = current.size();
+        rule(current.data(), next.data(), n * t / threads, n * (t + 1) / threads, ticks_done);
+    });
+}
+
+
+
+/** Sends back every B particle that moved onto a position held by another particle. Each thread counts the next positions that hash to it and chains the moves onto each of them, so no table is shared. Undoing a move can block other moves, so rounds repeat until nothing changes; a round undoes every move onto a position shared when the round starts, so the outcome depends neither on slot order nor on the number of threads. Only the positions that took back a particle are checked again.
+ @return the number of moves undone
+ */
+size_t Simulation::enforce_exclusivity() {
+    size_t n = next.size();
+    auto owns = [this](unsigned t, int pos) {return threads == 1 || mix_position(pos) % threads == t;};
+    next_mover.resize(n);
+    
+    run_pass([&](unsigned t) {
+        PositionIndex& occupied = occupancy[t];
+        occupied.clear();
+        occupied.reserve(n / threads);
+        check[t].clear();
+        for (size_t i = 0; i < n; ++i) {
+            int pos = next[i];
+            if (!owns(t, pos)) continue;
+            if (!exclusive[i] || pos == current[i])
+                occupied.insert(pos);
+            else if ((next_mover[i] = occupied.insert(pos, static_cast<uint32_t>(i))) == PositionIndex::NONE)
+                check[t].push_back(pos); // the first move onto the position
+        }
+    });
+    
+    size_t reverted = 0;
+    for (;;) {
+        run_pass([&](unsigned t) {
+            PositionIndex& occupied = occupancy[t];
+            undone[t].clear();
+            for (int pos : check[t]) {
+                if (occupied.count(pos) < 2) continue;
+                for (uint32_t i = occupied.head(pos); i != PositionIndex::NONE; i = next_mover[i])
+                    undone[t].push_back(i);
+                occupied.set_head(pos, PositionIndex::NONE);
+            }
+            check[t].clear();
+        });
+        
+        size_t round = 0;
+        for (const auto& x : undone)
+            round += x.size();
+        if (round == 0) break;
+        reverted += round;
+        
+        // each thread moves the undone particles out of and into its own positions; next itself is written once all have read it
+        run_pass([&](unsigned t) {
+            PositionIndex& occupied = occupancy[t];
+            for (const auto& x : undone)
+                for (size_t i : x) {
+                    if (owns(t, next[i]))
+                        occupied.erase(next[i]);
+                    if (owns(t, current[i])) {
+                        occupied.insert(current[i]);
+                        if (occupied.head(current[i]) != PositionIndex::NONE)
+                            check[t].push_back(current[i]);
+                    }
+                }
+        });
+        for (const auto& x : undone)
+            for (size_t i : x)
+                next[i] = current[i];
+    }
+    return reverted;
+}
+
+
+
+/** Advances the simulation by one tick: applies the rule, enforces B exclusivity, swaps the position arrays, and checks for collisions. Every parallel pass runs on the simulation's own workers.
+ @throws whatever the update rule threw on any thread; the positions are then left as they were before the tick
+ */
+void Simulation::step() {
+    auto start = std::chrono::steady_clock::now();
+    TickStats tick_stats;
+    
+    run_chunks();
+    auto updated = std::chrono::steady_clock::now();
+    tick_stats.update = std::chrono::duration<double>(updated - start).count();
+    
+    tick_stats.reverted = enforce_exclusivity();
+    current.swap(next);
+    auto resolved = std::chrono::steady_clock::now();
+    tick_stats.exclusivity = std::chrono::duration<double>(resolved - updated).count();
+    
+    collisions = CollisionDetector(threads).groups(current, [this](const std::function<void(unsigned)>& task) {run_pass(task);});
+    tick_stats.collision_groups = collisions.size();
+    auto finished = std::chrono::steady_clock::now();
+    tick_stats.collisions = std::chrono::duration<double>(finished - resolved).count();
+    tick_stats.total = std::chrono::duration<double>(finished - start).count();
+    
+    stats.push_back(tick_stats);
+    ++ticks_done;
+}
+
+
+
+/** Runs a number of ticks and then writes the positions back to the Board
+ @param ticks is the number of ticks
+ */
+void Simulation::run(size_t ticks) {
+    for (size_t i = 0; i < ticks; ++i)
+        step();
+    sync();
+}
+
+
+
+/** Writes the current positions back to the Board's particles and indexes
+ */
+void Simulation::sync() {
+    board.relocate(current);
+}
+
+
+
+/** Destructor for BoardSnapshot object. Unmaps the file.
+ */
+BoardSnapshot::~BoardSnapshot() {
+    close();
+}
+
+
+
+/** Memory-maps a snapshot file and checks its header. Nothing else is read until it is needed; the records are checked when they are used.
+ @param filename is the name of the file
+ @return true if the file is a valid snapshot, false if not
+ */
+bool BoardSnapshot::open(const std::string& filename) {
+    close();
+    
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping stays valid
+    if (mapping == MAP_FAILED) return false;
+    
+    data = mapping;
+    length = info.st_size;
+    
+    const Header* header = static_cast<const Header*>(data);
+    if (std::memcmp(header->magic, "BRDS", 4) != 0 || header->version != VERSION
+        || header->count > (length - sizeof(Header)) / sizeof(Record)
+        || header->heap_size != length - sizeof(Header) - header->count * sizeof(Record)) {
+        close();
+        return false;
+    }
+    
+    count = header->count;
+    records = reinterpret_cast<const Record*>(static_cast<const char*>(data) + sizeof(Header));
+    heap = reinterpret_cast<const char*>(records + count);
+    heap_size = header->heap_size;
+    return true;
+}
+
+
+
+/** Unmaps the file, leaving an empty snapshot
+ */
+void BoardSnapshot::close() {
+    if (data != nullptr)
+        munmap(data, length);
+    
+    data = nullptr;
+    length = count = heap_size = 0;
+    records = nullptr;
+    heap = nullptr;
+    PositionIndex().swap(index);
+    indexed = false;
+}
+
+
+
+/** Returns one record of the snapshot
+ @param i is the index of the particle
+ @return the record
+ */
+const BoardSnapshot::Record& BoardSnapshot::record(size_t i) const {
+    if (i >= count)
+        throw std::out_of_range("BoardSnapshot: particle index out of range");
+    return records[i];
+}
+
+
+
+/** Returns the type of a particle
+ @param i is the index of the particle
+ @return 'A' or 'B'
+ */
+char BoardSnapshot::type(size_t i) const {
+    return static_cast<char>(record(i).type);
+}
+
+
+
+/** Returns the position of a particle
+ @param i is the index of the particle
+ @return the position
+ */
+int BoardSnapshot::position(size_t i) const {
+    return record(i).position;
+}
+
+
+
+/** Returns the string property of an A particle
+ @param i is the index of the particle
+ @return the property
+ */
+std::string BoardSnapshot::a_property(size_t i) const {
+    uint64_t payload = record(i).payload;
+    uint64_t offset = payload & 0xFFFFFFFFu;
+    uint64_t bytes = payload >> 32;
+    if (record(i).type != 'A' || offset + bytes > heap_size)
+        throw std::out_of_range("BoardSnapshot: not an A particle or property outside the heap");
+    return std::string(heap + offset, bytes);
+}
+
+
+
+/** Returns the double property of a B particle
+ @param i is the index of the particle
+ @return the property
+ */
+double BoardSnapshot::b_property(size_t i) const {
+    if (record(i).type != 'B')
+        throw std::out_of_range("BoardSnapshot: not a B particle");
+    double prop;
+    std::memcpy(&prop, &records[i].payload, sizeof(prop));
+    return prop;
+}
+
+
+
+/** Returns true if a particle has position matching input position. The first call indexes every position in one pass over the mapping.
+ @param pos is the input position
+ @return true or false
+ */
+bool BoardSnapshot::ParticleInPosition(int pos) const {
+    if (!indexed) {
+        index.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            index.insert(records[i].position);
+        indexed = true;
+    }
+    return index.count(pos) > 0;
+}
+
+
+
+/** Constructs a Thing for every particle of the snapshot and adds it to a Board, in the saved order. B particles whose position is taken are dropped, as in Board::AddBParticle.
+ @param board is the Board to add to
+ @throws std::out_of_range if a record has an unknown type or an A property outside the heap, before anything is added
+ */
+void BoardSnapshot::AddTo(Board& board) const {
+    
+    // every record is checked before the first is added, so a damaged file cannot leave the Board half-filled
+    for (size_t i = 0; i < count; ++i) {
+        bool valid = records[i].type == 'B';
+        if (records[i].type == 'A')
+            valid = (records[i].payload & 0xFFFFFFFFu) + (records[i].payload >> 32) <= heap_size;
+        if (!valid)
+            throw std::out_of_range("BoardSnapshot: damaged record");
+    }
+    
+    board.things.reserve(board.things.size() + count);
+    board.pool.reserve(count, std::max(sizeof(ThingA), sizeof(ThingB)));
+    board.index.reserve(board.index.size() + count);
+    board.ordered.reserve(board.things.size() + count);
+    board.ids.reserve(board.things.size() + count);
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (records[i].type == 'A')
+            board.AddAParticle(records[i].position, a_property(i));
+        else
+            board.AddBParticle(records[i].position, b_property(i));
+    }
+}
+
+
+
+/** Overloads operator<< for BoardSnapshot object. Prints the same lines as the saved Board, through a TextWriter unless the stream formats differently.
+ @param out is the stream object with which to output
+ @param snapshot is the BoardSnapshot object
+ @return the stream object
+ */
+std::ostream& operator<<(std::ostream& out, const BoardSnapshot& snapshot) {
+    if (!TextWriter::formats_like(out)) {
+        for (size_t i = 0; i < snapshot.count; ++i) {
+            if (snapshot.records[i].type == 'A')
+                out << "A:" << snapshot.records[i].position << ":" << snapshot.a_property(i);
+            else
+                out << "B:" << snapshot.records[i].position << ":" << snapshot.b_property(i);
+            out << '\n';
+        }
+        return out;
+    }
+    
+    TextWriter writer(out);
+    for (size_t i = 0; i < snapshot.count; ++i) {
+        writer.write(snapshot.records[i].type == 'A' ? "A:" : "B:", 2);
+        writer.write(snapshot.records[i].position);
+        writer.write(':');
+        if (snapshot.records[i].type == 'A')
+            writer.write(snapshot.a_property(i));
+        else
+            writer.write(snapshot.b_property(i));
+        writer.write('\n');
+    }
+    writer.flush();
+    return out;
+}
+
+
+
+/** Appends an A particle to the columns
+ @param pos is the integer position of the particle
+ @param prop is the string property of the particle
+ */
+void ParticleColumns::push_a(int pos, std::string prop) {
+    positions.push_back(pos);
+    types.push_back(PARTICLE_A);
+    rows.push_back(static_cast<uint32_t>(a_properties.size()));
+    a_properties.push_back(std::move(prop));
+}
+
+
+
+/** Appends a B particle to the columns
+ @param pos is the integer position of the particle
+ @param prop is the double property of the particle
+ */
+void ParticleColumns::push_b(int pos, double prop) {
+    positions.push_back(pos);
+    types.push_back(PARTICLE_B);
+    rows.push_back(static_cast<uint32_t>(b_properties.size()));
+    b_properties.push_back(prop);
+}
+
+
+
+/** Prints out the type, position, and property of one particle in the same format as ThingA::print and ThingB::print
+ @param out is the output stream
+ @param i is the row of the particle
+ */
+void ParticleColumns::print(std::ostream& out, size_t i) const {
+    if (types[i] == PARTICLE_A)
+        out << "A:" << positions[i] << ":" << a_properties[rows[i]];
+    else
+        out << "B:" << positions[i] << ":" << b_properties[rows[i]];
+}
+
+
+
+/** Writes the type, position, and property of one particle into a TextWriter, in the same format as print(std::ostream&)
+ @param out is the writer
+ @param i is the row of the particle
+ */
+void ParticleColumns::print(TextWriter& out, size_t i) const {
+    out.write(types[i] == PARTICLE_A ? "A:" : "B:", 2);
+    out.write(positions[i]);
+    out.write(':');
+    if (types[i] == PARTICLE_A)
+        out.write(a_properties[rows[i]]);
+    else
+        out.write(b_properties[rows[i]]);
+}
+
+
+
+/** Returns true if a particle has position matching input position
+ @param pos is the input position
+ @return true or false
+ */
+bool ColumnBoard::ParticleInPosition(int pos) const {
+    return index.count(pos) > 0;
+}
+
+
+
+/** Adds an A particle to the ColumnBoard
+ @param pos is the integer position of the particle
+ @param prop is the string property of the particle
+ */
+void ColumnBoard::AddAParticle(int pos, std::string prop) {
+    columns.push_a(pos, std::move(prop));
+    index.insert(pos);
+}
+
+
+
+/** Adds a B particle to the ColumnBoard
+ @param pos is the integer position of the particle
+ @param prop is the double property of the particle
+ @return true if the particle was successfully added, false if not
+ */
+bool ColumnBoard::AddBParticle(int pos, double prop) {
+    
+    // If no particle is at position pos, then add, otherwise don't add.
+    if (ParticleInPosition(pos)) return false;
+    
+    columns.push_b(pos, prop);
+    index.insert(pos);
+    return true;
+}
+
+
+
+/** Overloads operator[] for ColumnBoard object so that it returns true if any particles on the board have position equal to the input value
+ @param n is the input value
+ @return a bool
+ */
+bool ColumnBoard::operator[](int n) {
+    return ParticleInPosition(n);
+}
+
+
+
+/** Overloads operator() for ColumnBoard object so that it returns true if any particles share the same position
+ @return a bool
+ */
+bool ColumnBoard::operator()() {
+    if (columns.size() == 1) return true; // matches Board for a single particle
+    return index.size() < columns.size();
+}
+
+
+
+/** Counts the particles at a position by scanning the position column
+ @param pos is the position
+ @return the number of particles
+ */
+size_t ColumnBoard::CountInPosition(int pos) const {
+    const int* p = columns.positions.data();
+    size_t count = 0;
+    for (size_t i = 0, n = columns.size(); i < n; ++i)
+        count += (p[i] == pos); // branch-free so the loop vectorizes
+    return count;
+}
+
+
+
+/** Counts the particles with positions in [lo, hi] by scanning the position column
+ @param lo is the lowest position counted
+ @param hi is the highest position counted
+ @return the number of particles
+ */
+size_t ColumnBoard::CountInRange(int lo, int hi) const {
+    const int* p = columns.positions.data();
+    size_t count = 0;
+    for (size_t i = 0, n = columns.size(); i < n; ++i)
+        count += (p[i] >= lo) & (p[i] <= hi);
+    return count;
+}
+
+
+
+/** Overloads operator<< for ColumnBoard object. Prints the same lines as Board, through a TextWriter unless the stream formats differently.
+ @param out is the stream object with which to output
+ @param board is the ColumnBoard object
+ @return the stream object
+ */
+std::ostream& operator<<(std::ostream& out, const ColumnBoard& board) {
+    if (!TextWriter::formats_like(out)) {
+        for (size_t i = 0, n = board.columns.size(); i < n; ++i) {
+            board.columns.print(out, i);
+            out << '\n';
+        }
+        return out;
+    }
+    
+    TextWriter writer(out);
+    for (size_t i = 0, n = board.columns.size(); i < n; ++i) {
+        board.columns.print(writer, i);
+        writer.write('\n');
+    }
+    writer.flush();
+    return out;
+}
+
+
+
+/** Swaps two CowBoards
+ @param other is the board to be swapped with
+ */
+void CowBoard::swap(CowBoard& other) {
+    storage.swap(other.storage);
+}
+
+
+
+/** Returns the chunk table, first copying it if another CowBoard still shares it
+ @return the chunk table
+ */
+CowBoard::Storage& CowBoard::writable_storage() {
+    if (storage.use_count() > 1)
+        storage = std::make_shared<Storage>(*storage); // copies pointers only
+    return *storage;
+}
+
+
+
+/** Returns the chunk that new particles go into, first copying it if another CowBoard still shares it
+ @return the last chunk
+ */
+ParticleColumns& CowBoard::writable_tail() {
+    Storage& table = writable_storage();
+    
+    if (table.chunks.empty() || table.chunks.back()->size() == CHUNK_SIZE)
+        table.chunks.push_back(std::make_shared<ParticleColumns>());
+    else if (table.chunks.back().use_count() > 1)
+        table.chunks.back() = std::make_shared<ParticleColumns>(*table.chunks.back());
+    
+    return *table.chunks.back();
+}
+
+
+
+/** Records a new particle position in its index shard, first copying the shard if another CowBoard still shares it
+ @param pos is the position
+ */
+void CowBoard::record_position(int pos) {
+    Storage& table = writable_storage();
+    std::shared_ptr<PositionIndex>& shard = table.shards[mix_position(pos) & (table.shards.size() - 1)];
+    
+    if (!shard)
+        shard = std::make_shared<PositionIndex>();
+    else if (shard.use_count() > 1)
+        shard = std::make_shared<PositionIndex>(*shard);
+    
+    if (shard->count(pos) == 0)
+        ++table.distinct;
+    shard->insert(pos);
+    ++table.particles;
+    
+    if (table.distinct > table.shards.size() * SHARD_POSITIONS)
+        split_shards(table);
+}
+
+
+
+/** Doubles the number of index shards, splitting each shard by the next bit of the position hash. The halves are new, so shards still shared with other CowBoards are only read; the cost is spread over the adds that filled the shards, as for a rehash.
+ @param table is the storage, already writable
+ */
+void CowBoard::split_shards(Storage& table) {
+    size_t count = table.shards.size();
+    std::vector<std::shared_ptr<PositionIndex>> halves(2 * count);
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (!table.shards[i]) continue;
+        halves[i] = std::make_shared<PositionIndex>();
+        halves[i + count] = std::make_shared<PositionIndex>();
+        table.shards[i]->partition([count](int pos) {return (mix_position(pos) & count) != 0;}, *halves[i + count], *halves[i]);
+    }
+    table.shards.swap(halves);
+}
+
+
+
+/** Returns true if a particle has position matching input position
+ @param pos is the input position
+ @return true or false
+ */
+bool CowBoard::ParticleInPosition(int pos) const {
+    const std::shared_ptr<PositionIndex>& shard = storage->shards[mix_position(pos) & (storage->shards.size() - 1)];
+    return shard && shard->count(pos) > 0;
+}
+
+
+
+/** Adds an A particle to the CowBoard
+ @param pos is the integer position of the particle
+ @param prop is the string property of the particle
+ */
+void CowBoard::AddAParticle(int pos, std::string prop) {
+    writable_tail().push_a(pos, std::move(prop));
+    record_position(pos);
+}
+
+
+
+/** Adds a B particle to the CowBoard
+ @param pos is the integer position of the particle
+ @param prop is the double property of the particle
+ @return true if the particle was successfully added, false if not
+ */
+bool CowBoard::AddBParticle(int pos, double prop) {
+    
+    // If no particle is at position pos, then add, otherwise don't add.
+    if (ParticleInPosition(pos)) return false;
+    
+    writable_tail().push_b(pos, prop);
+    record_position(pos);
+    return true;
+}
+
+
+
+/** Overloads operator[] for CowBoard object so that it returns true if any particles on the board have position equal to the input value
+ @param n is the input value
+ @return a bool
+ */
+bool CowBoard::operator[](int n) {
+    return ParticleInPosition(n);
+}
+
+
+
+/** Overloads operator() for CowBoard object so that it returns true if any particles share the same position
+ @return a bool
+ */
+bool CowBoard::operator()() {
+    if (storage->particles == 1) return true; // matches Board for a single particle
+    return storage->distinct < storage->particles;
+}
+
+
+
+/** Overloads operator<< for CowBoard object. Prints the same lines as Board, through a TextWriter unless the stream formats differently.
+ @param out is the stream object with which to output
+ @param board is the CowBoard object
+ @return the stream object
+ */
+std::ostream& operator<<(std::ostream& out, const CowBoard& board) {
+    if (!TextWriter::formats_like(out)) {
+        for (const auto& chunk : board.storage->chunks)
+            for (size_t i = 0, n = chunk->size(); i < n; ++i) {
+                chunk->print(out, i);
+                out << '\n';
+            }
+        return out;
+    }
+    
+    TextWriter writer(out);
+    for (const auto& chunk : board.storage->chunks)
+        for (size_t i = 0, n = chunk->size(); i < n; ++i) {
+            chunk->print(writer, i);
+            writer.write('\n');
+        }
+    writer.flush();
+    return out;
+}
+
+
+
+/** Returns the position of a particle of either type
+ @param particle is the particle
+ @return the position
+ */
+inline int get_position(const VariantBoard::Particle& particle) {
+    return std::visit([](const auto& x) {return x.position;}, particle);
+}
+
+
+
+/** Writes a ParticleA into a stream in the same format as ThingA::print
+ @param out is the stream
+ @param particle is the particle
+ */
+inline void print(std::ostream& out, const ParticleA& particle) {
+    out << "A:" << particle.position << ":" << particle.property;
+}
+
+
+
+/** Writes a ParticleB into a stream in the same format as ThingB::print
+ @param out is the stream
+ @param particle is the particle
+ */
+inline void print(std::ostream& out, const ParticleB& particle) {
+    out << "B:" << particle.position << ":" << particle.property;
+}
+
+
+
+/** Writes a ParticleA into a TextWriter in the same format as ThingA::print
+ @param out is the writer
+ @param particle is the particle
+ */
+inline void print(TextWriter& out, const ParticleA& particle) {
+    out.write("A:", 2);
+    out.write(particle.position);
+    out.write(':');
+    out.write(particle.property);
+}
+
+
+
+/** Writes a ParticleB into a TextWriter in the same format as ThingB::print
+ @param out is the writer
+ @param particle is the particle
+ */
+inline void print(TextWriter& out, const ParticleB& particle) {
+    out.write("B:", 2);
+    out.write(particle.position);
+    out.write(':');
+    out.write(particle.property);
+}
+
+
+
+/** Returns true if a particle has position matching input position
+ @param pos is the input position
+ @return true or false
+ */
+bool VariantBoard::ParticleInPosition(int pos) const {
+    return index.count(pos) > 0;
+}
+
+
+
+/** Adds an A particle to the VariantBoard
+ @param pos is the integer position of the particle
+ @param prop is the string property of the particle
+ */
+void VariantBoard::AddAParticle(int pos, std::string prop) {
+    particles.emplace_back(ParticleA{pos, std::move(prop)});
+    index.insert(pos);
+}
+
+
+
+/** Adds a B particle to the VariantBoard
+ @param pos is the integer position of the particle
+ @param prop is the double property of the particle
+ @return true if the particle was successfully added, false if not
+ */
+bool VariantBoard::AddBParticle(int pos, double prop) {
+    
+    // If no particle is at position pos, then add, otherwise don't add.
+    if (ParticleInPosition(pos)) return false;
+    
+    particles.emplace_back(ParticleB{pos, prop});
+    index.insert(pos);
+    return true;
+}
+
+
+
+/** Overloads operator[] for VariantBoard object so that it returns true if any particles on the board have position equal to the input value
+ @param n is the input value
+ @return a bool
+ */
+bool VariantBoard::operator[](int n) {
+    return ParticleInPosition(n);
+}
+
+
+
+/** Overloads operator() for VariantBoard object so that it returns true if any particles share the same position
+ @return a bool
+ */
+bool VariantBoard::operator()() {
+    if (particles.size() == 1) return true; // matches Board for a single particle
+    return index.size() < particles.size();
+}
+
+
+
+/** Copies the particle positions into a contiguous array, in the order the particles were added
+ @return the positions
+ */
+std::vector<int> VariantBoard::Positions() const {
+    std::vector<int> positions;
+    positions.reserve(particles.size());
+    for (const auto& x : particles)
+        positions.push_back(get_position(x));
+    return positions;
+}
+
+
+
+/** Counts the particles at a position by visiting every particle
+ @param pos is the position
+ @return the number of particles
+ */
+size_t VariantBoard::CountInPosition(int pos) const {
+    size_t count = 0;
+    for (const auto& x : particles)
+        count += (get_position(x) == pos);
+    return count;
+}
+
+
+
+/** Overloads operator<< for VariantBoard object. Prints the same lines as Board, through a TextWriter unless the stream formats differently.
+ @param out is the stream object with which to output
+ @param board is the VariantBoard object
+ @return the stream object
+ */
+std::ostream& operator<<(std::ostream& out, const VariantBoard& board) {
+    if (!TextWriter::formats_like(out)) {
+        for (const auto& x : board.particles) {
+            std::visit([&](const auto& particle) {print(out, particle);}, x);
+            out << '\n';
+        }
+        return out;
+    }
+    
+    TextWriter writer(out);
+    for (const auto& x : board.particles) {
+        std::visit([&](const auto& particle) {print(writer, particle);}, x);
+        writer.write('\n');
+    }
+    writer.flush();
+    return out;
+}
+
+
+
+/** Tells whether a TextWriter prints the same characters as a stream would. TextWriter reproduces the default formatting only, so streams with custom flags, a locale or a pending width must format through the stream itself.
+ @param out is the stream
+ @return true if the stream has default flags, the classic locale and no pending width
+ */
+bool TextWriter::formats_like(const std::ostream& out) {
+    const std::ios_base::fmtflags custom = std::ios_base::floatfield | std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase | (std::ios_base::basefield & ~std::ios_base::dec);
+    return (out.flags() & custom) == 0 && out.getloc() == std::locale::classic() && out.width() == 0;
+}
+
+
+
+/** Constructor for TextWriter that writes to a stream. Doubles use the stream's precision.
+ @param out is the stream
+ */
+TextWriter::TextWriter(std::ostream& out) : buffer(new char[CAPACITY]), used(0), stream(&out), fd(-1), precision(static_cast<int>(out.precision())), ok(true) {}
+
+
+
+/** Constructor for TextWriter that writes to a file descriptor. Doubles use the default stream precision of 6.
+ @param file_descriptor is the file descriptor
+ */
+TextWriter::TextWriter(int file_descriptor) : buffer(new char[CAPACITY]), used(0), stream(nullptr), fd(file_descriptor), precision(6), ok(true) {}
+
+
+
+/** Destructor for TextWriter object. Writes out whatever is left in the buffer.
+ */
+TextWriter::~TextWriter() {
+    flush();
+}
+
+
+
+/** Makes room for n more characters, writing out the buffer first if they do not fit
+ @param n is the number of characters, at most CAPACITY
+ @return where the characters go
+ */
+char* TextWriter::reserve(size_t n) {
+    if (used + n > CAPACITY)
+        flush();
+    return buffer.get() + used;
+}
+
+
+
+/** Appends characters to the buffer. Strings longer than the buffer are written out directly.
+ @param s points to the characters
+ @param n is the number of characters
+ */
+void TextWriter::write(const char* s, size_t n) {
+    if (n > CAPACITY) {
+        flush();
+        send(s, n);
+        return;
+    }
+    std::memcpy(reserve(n), s, n);
+    used += n;
+}
+
+
+
+/** Appends one character to the buffer
+ @param c is the character
+ */
+void TextWriter::write(char c) {
+    *reserve(1) = c;
+    ++used;
+}
+
+
+
+/** Appends an int in decimal. A failed conversion is reported by flush.
+ @param n is the int
+ */
+void TextWriter::write(int n) {
+    char* first = reserve(16);
+    std::to_chars_result result = std::to_chars(first, first + 16, n);
+    if (result.ec == std::errc()) used += result.ptr - first;
+    else ok = false;
+}
+
+
+
+/** Appends a double the way an ostream with default flags prints it, which is printf's %g at the writer's precision. A failed conversion is reported by flush.
+ @param x is the double
+ */
+void TextWriter::write(double x) {
+    // %g needs at most the significant digits plus a sign, a point, leading zeros and an exponent
+    size_t n = static_cast<size_t>(std::max(precision, 0)) + 32;
+    std::string spill; // for precisions too large for the buffer
+    char* first = n <= CAPACITY ? reserve(n) : (spill.resize(n), &spill[0]);
+    std::to_chars_result result = std::to_chars(first, first + n, x, std::chars_format::general, precision);
+    if (result.ec != std::errc()) ok = false;
+    else if (spill.empty()) used += result.ptr - first;
+    else write(first, result.ptr - first);
+}
+
+
+
+/** Writes out and empties the buffer
+ @return true if everything written so far has been accepted, false if not
+ */
+bool TextWriter::flush() {
+    send(buffer.get(), used);
+    used = 0;
+    return ok;
+}
+
+
+
+/** Hands characters to the stream or file descriptor, retrying partial and interrupted writes
+ @param s points to the characters
+ @param n is the number of characters
+ */
+void TextWriter::send(const char* s, size_t n) {
+    if (stream != nullptr) {
+        stream->write(s, n);
+        ok = ok && static_cast<bool>(*stream);
+        return;
+    }
+    
+    for (size_t done = 0; done < n && ok; ) {
+        ssize_t written = ::write(fd, s + done, n - done);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) ok = false;
+        else done += written;
+    }
+}
+
+
+
+/** Records a particle position for range queries
+ @param pos is the position
+ @param id is the ID of the particle
+ */
+void RangeIndex::insert(int pos, int id) {
+    pending.push_back(Entry{pos, id});
+}
+
+
+
+/** Forgets a particle position. The entry stays in place until the next query compacts it out, or until erased entries make up half of the index, so churn without queries does not grow it.
+ @param pos is the position the particle was recorded with
+ @param id is the ID of the particle
+ */
+void RangeIndex::erase(int pos, int id) {
+    removed.push_back(Entry{pos, id});
+    if (2 * removed.size() > sorted.size() + pending.size())
+        settle();
+}
+
+
+
+/** Makes room for n entries without reallocating
+ @param n is the number of entries
+ */
+void RangeIndex::reserve(size_t n) {
+    pending.reserve(n > sorted.size() ? n - sorted.size() : 0);
+}
+
+
+
+/** Swaps two RangeIndex objects
+ @param other is the index to be swapped with
+ */
+void RangeIndex::swap(RangeIndex& other) {
+    sorted.swap(other.sorted);
+    pending.swap(other.pending);
+    removed.swap(other.removed);
+}
+
+
+
+/** Gives every entry a new ID without sorting the index again. Only entries that share a position can change order, so each run of equal positions is sorted on its own.
+ @param new_id maps an old ID to its new one; it must be one-to-one, and an ID it returns unchanged must not be the new ID of another entry
+ */
+void RangeIndex::rename(const std::function<int(int)>& new_id) {
+    for (auto* entries : {&sorted, &pending, &removed})
+        for (auto& x : *entries)
+            x.id = new_id(x.id);
+    
+    for (size_t first = 0, n = sorted.size(); first < n; ) {
+        size_t last = first + 1;
+        while (last < n && sorted[last].position == sorted[first].position) ++last;
+        if (last - first > 1) std::sort(sorted.begin() + first, sorted.begin() + last);
+        first = last;
+    }
+}
+
+
+
+/** Sorts the entries added since the last query and merges them into the sorted array, then drops the erased entries in one pass over it. Queries call it themselves; a batch of insertions can call it to pay for the sort at once.
+ */
+void RangeIndex::settle() const {
+    if (!pending.empty()) {
+        std::sort(pending.begin(), pending.end());
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), pending.begin(), pending.end());
+        std::inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end());
+        pending.clear();
+    }
+    if (removed.empty()) return;
+    
+    // IDs are never reused, so each erased entry matches exactly one sorted entry
+    std::sort(removed.begin(), removed.end());
+    auto doomed = removed.cbegin();
+    auto kept = std::remove_if(sorted.begin(), sorted.end(), [&](const Entry& x) {
+        while (doomed != removed.cend() && *doomed < x) ++doomed;
+        return doomed != removed.cend() && *doomed == x;
+    });
+    sorted.erase(kept, sorted.end());
+    removed.clear();
+}
+
+
+
+/** Counts the entries with positions in [lo, hi] with two binary searches
+ @param lo is the lowest position counted
+ @param hi is the highest position counted
+ @return the number of entries
+ */
+size_t RangeIndex::count(int lo, int hi) const {
+    if (lo > hi) return 0;
+    settle();
+    
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), lo, [](const Entry& x, int pos) {return x.position < pos;});
+    auto last = std::upper_bound(first, sorted.end(), hi, [](int pos, const Entry& x) {return pos < x.position;});
+    return last - first;
+}
+
+
+
+/** Lists the IDs of the entries with positions in [lo, hi]
+ @param lo is the lowest position listed
+ @param hi is the highest position listed
+ @return the IDs, ordered by position and then by ID
+ */
+std::vector<int> RangeIndex::find(int lo, int hi) const {
+    std::vector<int> found;
+    if (lo > hi) return found;
+    settle();
+    
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), lo, [](const Entry& x, int pos) {return x.position < pos;});
+    for (auto x = first; x != sorted.end() && x->position <= hi; ++x)
+        found.push_back(x->id);
+    return found;
+}
+
+
+
+/** Destructor for ThingPool object. Releases every block at once.
+ */
+ThingPool::~ThingPool() {
+    for (const auto& x : blocks)
+        ::operator delete(x);
+}
+
+
+
+/** Rounds a size up to the strictest fundamental alignment
+ @param size is the number of bytes
+ @return the rounded size
+ */
+size_t ThingPool::round_up(size_t size) {
+    const size_t align = alignof(std::max_align_t);
+    return (size + align - 1) / align * align;
+}
+
+
+
+/** Hands out memory for one object from the newest block, starting a new block when it runs out
+ @param size is the number of bytes needed
+ @return a pointer to the memory
+ */
+void* ThingPool::allocate(size_t size) {
+    size = round_up(size);
+    for (auto& x : free_lists) {
+        if (x.size == size && x.head) {
+            void* p = x.head;
+            x.head = *static_cast<void**>(p);
+            used += size;
+            return p;
+        }
+    }
+    if (size > remaining)
+        reserve(std::max(size, BLOCK_SIZE));
+    
+    void* p = current;
+    current += size;
+    remaining -= size;
+    used += size;
+    return p;
+}
+
+
+
+/** Gives back the memory of one object so the next allocation of the same size can reuse it
+ @param p is the memory, handed out by this pool
+ @param size is the size it was allocated with
+ */
+void ThingPool::deallocate(void* p, size_t size) {
+    size = round_up(size);
+    used -= size;
+    
+    auto list = std::find_if(free_lists.begin(), free_lists.end(), [size](const FreeList& x) {return x.size == size;});
+    if (list == free_lists.end()) {
+        free_lists.push_back(FreeList{size, nullptr});
+        list = free_lists.end() - 1;
+    }
+    *static_cast<void**>(p) = list->head;
+    list->head = p;
+}
+
+
+
+/** Makes sure the next allocations totalling at most a given number of bytes come from a single block
+ @param bytes is the number of bytes
+ */
+void ThingPool::reserve(size_t bytes) {
+    if (bytes <= remaining) return;
+    
+    bytes = round_up(bytes);
+    blocks.reserve(blocks.size() + 1);
+    current = static_cast<char*>(::operator new(bytes));
+    blocks.push_back(current);
+    remaining = bytes;
+    ++blocks_allocated;
+}
+
+
+
+/** Takes over every block and free chunk of another pool, leaving it empty. Allocation continues from this pool's own newest block.
+ @param other is the pool whose blocks are taken
+ */
+void ThingPool::absorb(ThingPool& other) {
+    blocks.insert(blocks.end(), other.blocks.begin(), other.blocks.end());
+    used += other.used;
+    for (const auto& x : other.free_lists)
+        for (void* p = x.head; p; ) {
+            void* next = *static_cast<void**>(p);
+            used += x.size; // deallocate takes it off again
+            deallocate(p, x.size);
+            p = next;
+        }
+    
+    other.blocks.clear();
+    other.free_lists.clear();
+    other.current = nullptr;
+    other.remaining = 0;
+    other.used = 0;
+}
+
+
+
+/** Makes sure the next count allocations of a given size come from a single block
+ @param count is the number of objects
+ @param size is the size of each object
+ */
+void ThingPool::reserve(size_t count, size_t size) {
+    reserve(count * round_up(size));
+}
+
+
+
+/** Swaps two ThingPools
+ @param other is the pool to be swapped with
+ */
+void ThingPool::swap(ThingPool& other) {
+    blocks.swap(other.blocks);
+    free_lists.swap(other.free_lists);
+    std::swap(current, other.current);
+    std::swap(remaining, other.remaining);
+    std::swap(used, other.used);
+}
+
+
+
+/** Returns the slot where the probe sequence of a position starts
+ @param pos is the position
+ @return the index of the slot
+ */
+size_t PositionIndex::home_slot(int pos) const {
+    return fibonacci_slot(pos, slots.size() - 1);
+}
+
+
+
+/** Finds the slot holding a position, or the empty slot where it would be inserted
+ @param pos is the position to look for
+ @return the index of the slot
+ */
+size_t PositionIndex::find_slot(int pos) const {
+    size_t mask = slots.size() - 1;
+    size_t i = home_slot(pos);
+    
+    while (slots[i].count != 0 && slots[i].key != pos)
+        i = (i + 1) & mask;
+    return i;
+}
+
+
+
+/** Rebuilds the table with a new capacity
+ @param capacity is the new number of slots, must be a power of two
+ */
+void PositionIndex::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{0, 0, NONE});
+    old.swap(slots);
+    
+    for (const auto& x : old)
+        if (x.count != 0)
+            slots[find_slot(x.key)] = x;
+}
+
+
+
+/** Returns the number of particles at a position
+ @param pos is the position
+ @return the number of particles
+ */
+int PositionIndex::count(int pos) const {
+    if (slots.empty()) return 0;
+    return slots[find_slot(pos)].count;
+}
+
+
+
+/** Returns the head stored with a position
+ @param pos is the position
+ @return the head, or NONE if the position is not recorded or has no head
+ */
+uint32_t PositionIndex::head(int pos) const {
+    if (slots.empty()) return NONE;
+    const Slot& slot = slots[find_slot(pos)];
+    return slot.count == 0 ? NONE : slot.head;
+}
+
+
+
+/** Records one more particle at a position. The head of a position already recorded is kept.
+ @param pos is the position
+ */
+void PositionIndex::insert(int pos) {
+    if (2 * (used + 1) > slots.size())
+        rehash(slots.empty() ? 16 : 2 * slots.size());
+    
+    Slot& slot = slots[find_slot(pos)];
+    if (slot.count == 0) {
+        slot.key = pos;
+        slot.head = NONE;
+        ++used;
     }
-    return false;
+    ++slot.count;
 }
 
 
 
-/** Overloads operator<< for Board object
- @param out is the stream object with which to output
- @param board is the Board object
- @return the stream object
+/** Records one more particle at a position and makes a slot the new head of the position
+ @param pos is the position
+ @param head is the new head
+ @return the previous head, or NONE if the position was not recorded
  */
-std::ostream& operator<<(std::ostream& out, const Board& board) {
-    for (const auto& x : board.things) {
-        x->print(out);
-        out << std::endl;
+uint32_t PositionIndex::insert(int pos, uint32_t head) {
+    
+    // keeps the load factor at or below 1/2 so probe sequences stay short
+    if (2 * (used + 1) > slots.size())
+        rehash(slots.empty() ? 16 : 2 * slots.size());
+    
+    Slot& slot = slots[find_slot(pos)];
+    uint32_t previous = NONE;
+    if (slot.count == 0) {
+        slot.key = pos;
+        ++used;
     }
-    return out;
+    else previous = slot.head;
+    ++slot.count;
+    slot.head = head;
+    return previous;
 }
 
 
 
-/** Overloads operator[] for Board object so that it returns true if any particles on the board have position equal to the input value
- @param n is the input value
- @return a bool
+/** Records a position with one particle, unless the position is already recorded
+ @param pos is the position
+ @param head is the head of the new position
+ @return true if the position was new, false if it was already recorded and nothing changed
  */
-bool Board::operator[](int n) {
-    for (const auto& x : things)
-        if (x->get_position() == n)
-            return true;
-    return false;
+bool PositionIndex::insert_new(int pos, uint32_t head) {
+    if (2 * (used + 1) > slots.size())
+        rehash(slots.empty() ? 16 : 2 * slots.size());
+    
+    Slot& slot = slots[find_slot(pos)];
+    if (slot.count != 0) return false;
+    slot = Slot{pos, 1, head};
+    ++used;
+    return true;
 }
 
 
 
-/** Overloads operator() for Board object so that it returns true if any particles in Board share the same position
- @return a bool
+/** Replaces the head of a recorded position. A position that is not recorded is left alone.
+ @param pos is the position
+ @param head is the new head
  */
-bool Board::operator()() {
-    if (things.size() == 1) return true; // if Board stores only one particle
+void PositionIndex::set_head(int pos, uint32_t head) {
+    if (slots.empty()) return;
+    Slot& slot = slots[find_slot(pos)];
+    if (slot.count != 0) slot.head = head;
+}
+
+
+
+/** Sets the head of every position to NONE in one pass over the table
+ */
+void PositionIndex::clear_heads() {
+    for (auto& x : slots)
+        x.head = NONE;
+}
+
+
+
+/** Records one less particle at a position. A position whose count drops to zero is removed by shifting later entries of its probe run back, so no tombstones are left behind.
+ @param pos is the position
+ @return true if a particle was recorded at the position, false if not
+ */
+bool PositionIndex::erase(int pos) {
+    if (slots.empty()) return false;
+    
+    size_t i = find_slot(pos);
+    if (slots[i].count == 0) return false;
+    if (--slots[i].count > 0) return true;
+    --used;
+    
+    // moves back every later entry of the run whose home slot is not between the hole and itself
+    size_t mask = slots.size() - 1;
+    for (size_t j = (i + 1) & mask; slots[j].count != 0; j = (j + 1) & mask) {
+        size_t home = home_slot(slots[j].key);
+        bool stays = (i < j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].count = 0;
+    return true;
+}
+
+
+
+/** Forgets every position but keeps the table, so filling it again does not allocate
+ */
+void PositionIndex::clear() {
+    std::fill(slots.begin(), slots.end(), Slot{0, 0, NONE});
+    used = 0;
+}
+
+
+
+/** Makes room for at least n distinct positions without rehashing
+ @param n is the number of positions
+ */
+void PositionIndex::reserve(size_t n) {
+    size_t capacity = 16;
+    while (capacity < 2 * n)
+        capacity *= 2;
+    if (capacity > slots.size())
+        rehash(capacity);
+}
+
+
+
+/** Swaps two PositionIndex objects
+ @param other is the index to be swapped with
+ */
+void PositionIndex::swap(PositionIndex& other) {
+    slots.swap(other.slots);
+    std::swap(used, other.used);
+}
+
+
+
+/** Copies every position, with its count and head, into one of two indexes
+ @param pred tells which index a position goes into
+ @param yes receives the positions pred holds for
+ @param no receives the other positions
+ */
+void PositionIndex::partition(const std::function<bool(int)>& pred, PositionIndex& yes, PositionIndex& no) const {
+    yes.reserve(used);
+    no.reserve(used);
+    for (const auto& x : slots) {
+        if (x.count == 0) continue;
+        PositionIndex& target = pred(x.key) ? yes : no;
+        target.slots[target.find_slot(x.key)] = x;
+        ++target.used;
+    }
+}
+
+
+
+/** Finds the slot holding a key, or the empty slot where it would be inserted
+ @param key is the key to look for
+ @return the index of the slot
+ */
+size_t SlotIndex::find_slot(int key) const {
+    size_t mask = slots.size() - 1;
+    size_t i = fibonacci_slot(key, mask);
+    
+    while (slots[i].value != NONE && slots[i].key != key)
+        i = (i + 1) & mask;
+    return i;
+}
+
+
+
+/** Rebuilds the table with a new capacity
+ @param capacity is the new number of slots, must be a power of two
+ */
+void SlotIndex::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{0, NONE});
+    old.swap(slots);
+    
+    for (const auto& x : old)
+        if (x.value != NONE)
+            slots[find_slot(x.key)] = x;
+}
+
+
+
+/** Returns the value stored for a key
+ @param key is the key
+ @return the value, or NONE if the key is not stored
+ */
+uint32_t SlotIndex::find(int key) const {
+    if (slots.empty()) return NONE;
+    return slots[find_slot(key)].value;
+}
+
+
+
+/** Stores a value for a key, replacing any value already stored for it
+ @param key is the key
+ @param value is the value, must not be NONE
+ */
+void SlotIndex::assign(int key, uint32_t value) {
+    if (2 * (used + 1) > slots.size())
+        rehash(slots.empty() ? 16 : 2 * slots.size());
+    
+    Slot& slot = slots[find_slot(key)];
+    if (slot.value == NONE) {
+        slot.key = key;
+        ++used;
+    }
+    slot.value = value;
+}
+
+
+
+/** Removes a key, shifting later entries of its probe run back as PositionIndex::erase does
+ @param key is the key
+ @return true if the key was stored, false if not
+ */
+bool SlotIndex::erase(int key) {
+    if (slots.empty()) return false;
+    
+    size_t i = find_slot(key);
+    if (slots[i].value == NONE) return false;
+    --used;
+    
+    size_t mask = slots.size() - 1;
+    for (size_t j = (i + 1) & mask; slots[j].value != NONE; j = (j + 1) & mask) {
+        size_t home = fibonacci_slot(slots[j].key, mask);
+        bool stays = (i < j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].value = NONE;
+    return true;
+}
+
+
+
+/** Makes room for at least n keys without rehashing
+ @param n is the number of keys
+ */
+void SlotIndex::reserve(size_t n) {
+    size_t capacity = 16;
+    while (capacity < 2 * n)
+        capacity *= 2;
+    if (capacity > slots.size())
+        rehash(capacity);
+}
+
+
+
+/** Swaps two SlotIndex objects
+ @param other is the index to be swapped with
+ */
+void SlotIndex::swap(SlotIndex& other) {
+    slots.swap(other.slots);
+    std::swap(used, other.used);
+}
+
+
+
+#ifdef BOARD_BENCHMARK
+#include <cstdlib>
+#include <cstdio>
+
+static size_t heap_allocations = 0; // calls to the global operator new, for measurement
+
+void* operator new(size_t size) {
+    ++heap_allocations;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+/** Returns the seconds elapsed since a starting time
+ @param start is the starting time
+ @return the elapsed seconds
+ */
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+/** Times filling a board with n B particles through the position index against the old linear scan over the particle list
+ @param n is the number of particles
+ */
+void benchmark_position_lookup(int n) {
     
-    else {
-        for (size_t i = 0, n = things.size(); i < n-1; ++i) {
-            int pos = things[i]->get_position();
-            for (size_t j = i+1; j < n; ++j) {
-                if (pos == things[j]->get_position())
-                    return true;
+    auto start = std::chrono::steady_clock::now();
+    Board indexed;
+    for (int i = 0; i < n; ++i)
+        indexed.AddBParticle(i, 0.5);
+    double indexed_time = seconds_since(start);
+    
+    // replays the old AddBParticle: a full scan with a virtual call per particle before each insert
+    start = std::chrono::steady_clock::now();
+    Board owner;
+    std::vector<Thing*> scanned;
+    for (int i = 0; i < n; ++i) {
+        bool found = false;
+        for (const auto& x : scanned)
+            if (x->get_position() == i) {
+                found = true;
+                break;
             }
+        if (!found)
+            scanned.push_back(new ThingB(i, 0.5, owner));
+    }
+    double scan_time = seconds_since(start);
+    for (const auto& x : scanned)
+        delete x;
+    
+    std::cerr << "AddBParticle x " << n << ": index " << indexed_time << " s, scan " << scan_time << " s" << std::endl;
+}
+
+
+
+/** Times collision detection over n positions, a quarter of which repeat, serially and with every hardware thread
+ @param n is the number of positions
+ */
+void benchmark_collisions(int n) {
+    
+    std::vector<int> positions(n);
+    for (int i = 0; i < n; ++i)
+        positions[i] = (i % 4 == 0) ? i / 2 : i;
+    
+    auto start = std::chrono::steady_clock::now();
+    size_t serial = CollisionDetector(1).groups(positions).size();
+    double serial_time = seconds_since(start);
+    
+    unsigned threads = std::thread::hardware_concurrency();
+    start = std::chrono::steady_clock::now();
+    size_t parallel = CollisionDetector(threads).groups(positions).size();
+    double parallel_time = seconds_since(start);
+    
+    std::cerr << "Collisions x " << n << ": " << serial << " groups serial " << serial_time << " s, " << parallel << " groups on " << threads << " threads " << parallel_time << " s" << std::endl;
+}
+
+
+
+/** Times a full position scan over n particles stored as Things against the same scan over a ColumnBoard
+ @param n is the number of particles
+ */
+void benchmark_column_scan(int n) {
+    
+    Board things;
+    ColumnBoard columns;
+    for (int i = 0; i < n; ++i) {
+        things.AddAParticle(i % 1000, "red");
+        columns.AddAParticle(i % 1000, "red");
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (int pos = 0; pos < 100; ++pos)
+        for (const auto& x : things.Positions()) // includes the pointer-chasing copy
+            found += (x == pos);
+    double things_time = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    size_t scanned = 0;
+    for (int pos = 0; pos < 100; ++pos)
+        scanned += columns.CountInPosition(pos);
+    double columns_time = seconds_since(start);
+    
+    std::cerr << "100 scans x " << n << ": Things " << things_time << " s (" << found << "), columns " << columns_time << " s (" << scanned << ")" << std::endl;
+}
+
+
+
+/** Counts heap allocations and times copying and destroying a Board of n particles, cloning each Thing onto the heap against cloning into the pool. Both copies build the same indexes, so only the allocation of the clones differs.
+ @param n is the number of particles
+ */
+void benchmark_copy(int n) {
+    
+    Board board;
+    for (int i = 0; i < n; ++i) {
+        if (i % 2 == 0) board.AddAParticle(i, "red");
+        else board.AddBParticle(i, 0.5);
+    }
+    
+    // the old copy: one new per clone and one delete per particle
+    size_t allocations = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    {
+        Board copy;
+        copy.things.reserve(board.things.size());
+        for (const auto& x : board.things)
+            copy.things.push_back(x->clone());
+        copy.copy_indexes(board);
+        for (const auto& x : copy.things)
+            delete x;
+        copy.things.clear();
+    }
+    double heap_time = seconds_since(start);
+    size_t heap_count = heap_allocations - allocations;
+    
+    allocations = heap_allocations;
+    start = std::chrono::steady_clock::now();
+    {
+        Board copy(board);
+    }
+    double pool_time = seconds_since(start);
+    size_t pool_count = heap_allocations - allocations;
+    
+    std::cerr << "Copy and destroy x " << n << ": heap clones " << heap_count << " allocations " << heap_time << " s, pooled " << pool_count << " allocations " << pool_time << " s" << std::endl;
+}
+
+
+
+/** Times 100 ticks of snapshot-then-add-one-particle on boards of n particles, deep-copying a Board against sharing a CowBoard
+ @param n is the number of particles
+ */
+void benchmark_snapshots(int n) {
+    
+    Board board;
+    CowBoard cow;
+    for (int i = 0; i < n; ++i) {
+        board.AddBParticle(i, 0.5);
+        cow.AddBParticle(i, 0.5);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Board> board_checkpoints;
+    for (int tick = 0; tick < 100; ++tick) {
+        board_checkpoints.push_back(board);
+        board.AddBParticle(n + tick, 0.5);
+    }
+    double board_time = seconds_since(start);
+    
+    size_t allocations = heap_allocations;
+    start = std::chrono::steady_clock::now();
+    std::vector<CowBoard> cow_checkpoints;
+    for (int tick = 0; tick < 100; ++tick) {
+        cow_checkpoints.push_back(cow);
+        cow.AddBParticle(n + tick, 0.5);
+    }
+    double cow_time = seconds_since(start);
+    
+    std::cerr << "100 checkpoints x " << n << ": Board " << board_time << " s, CowBoard " << cow_time << " s (" << heap_allocations - allocations << " allocations)" << std::endl;
+}
+
+
+
+/** Times loading n B records, a tenth of which repeat a position, one AddBParticle call at a time against a single AddBParticles batch
+ @param n is the number of records
+ */
+void benchmark_batch_ingestion(int n) {
+    
+    std::vector<BRecord> records(n);
+    for (int i = 0; i < n; ++i)
+        records[i] = BRecord{(i % 10 == 0) ? i / 2 : i, 0.5};
+    
+    size_t allocations = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    Board single;
+    size_t single_rejected = 0;
+    for (const auto& x : records)
+        single_rejected += !single.AddBParticle(x.position, x.property);
+    double single_time = seconds_since(start);
+    size_t single_count = heap_allocations - allocations;
+    
+    allocations = heap_allocations;
+    start = std::chrono::steady_clock::now();
+    Board batch;
+    size_t batch_rejected = batch.AddBParticles(records).size();
+    double batch_time = seconds_since(start);
+    size_t batch_count = heap_allocations - allocations;
+    
+    std::cerr << "Ingest x " << n << ": one at a time " << single_time << " s, " << single_count << " allocations, " << single_rejected << " rejected; batch " << batch_time << " s, " << batch_count << " allocations, " << batch_rejected << " rejected" << std::endl;
+}
+
+
+
+/** Times saving a board of n particles, mapping the snapshot back in and answering a lookup from it, against rebuilding a Board from the snapshot
+ @param n is the number of particles
+ */
+void benchmark_snapshot_load(int n) {
+    
+    Board board;
+    for (int i = 0; i < n; ++i) {
+        if (i % 2 == 0) board.AddAParticle(i, "red");
+        else board.AddBParticle(i, 0.5);
+    }
+    
+    const std::string filename = "hw1_benchmark.snapshot";
+    auto start = std::chrono::steady_clock::now();
+    board.SaveSnapshot(filename);
+    double save_time = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    BoardSnapshot snapshot;
+    snapshot.open(filename);
+    double open_time = seconds_since(start);
+    bool found = snapshot.ParticleInPosition(n - 1);
+    double lookup_time = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    Board rebuilt;
+    snapshot.AddTo(rebuilt);
+    double rebuild_time = seconds_since(start);
+    
+    std::remove(filename.c_str());
+    std::cerr << "Snapshot x " << n << ": save " << save_time << " s, open " << open_time << " s, open + first lookup " << lookup_time << " s (" << found << "), full rebuild " << rebuild_time << " s" << std::endl;
+}
+
+
+
+/** Times printing a board of n particles to /dev/null with a flushed line per particle as before, through operator<<, and through Export to a file descriptor
+ @param n is the number of particles
+ */
+void benchmark_text_export(int n) {
+    
+    Board board;
+    for (int i = 0; i < n; ++i) {
+        if (i % 2 == 0) board.AddAParticle(i, "red");
+        else board.AddBParticle(i, 2.71828 * i);
+    }
+    std::vector<int> positions = board.Positions();
+    
+    std::ofstream fout("/dev/null");
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        if (i % 2 == 0) fout << "A:" << positions[i] << ":" << "red";
+        else fout << "B:" << positions[i] << ":" << 2.71828 * i;
+        fout << std::endl;
+    }
+    double flushed_time = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    fout << board;
+    fout.flush();
+    double stream_time = seconds_since(start);
+    
+    int fd = ::open("/dev/null", O_WRONLY);
+    start = std::chrono::steady_clock::now();
+    board.Export(fd);
+    double fd_time = seconds_since(start);
+    ::close(fd);
+    
+    std::cerr << "Print x " << n << ": flushed lines " << flushed_time << " s, operator<< " << stream_time << " s, Export " << fd_time << " s" << std::endl;
+}
+
+
+
+/** Times growing a vector to n Boards of 1000 particles each, where every reallocation relocates the Boards already stored. Counts the heap allocations made by the relocations, which deep copies would make per particle.
+ @param n is the number of Boards
+ */
+void benchmark_board_container(int n) {
+    
+    std::vector<Board> boards;
+    size_t relocation_allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        Board board;
+        for (int j = 0; j < 1000; ++j)
+            board.AddAParticle(j, "particle with a heap-allocated property");
+        
+        size_t allocations = heap_allocations;
+        boards.push_back(std::move(board));
+        relocation_allocations += heap_allocations - allocations;
+    }
+    double time = seconds_since(start);
+    
+    std::cerr << "vector<Board> x " << n << ": " << time << " s, " << relocation_allocations << " allocations in push_back" << std::endl;
+}
+
+
+
+/** Times 10 ticks of a random walk of n particles, two thirds of them B, on a given number of threads, and reports the average time of each phase
+ @param n is the number of particles
+ @param n_threads is the number of threads
+ */
+void benchmark_simulation(int n, unsigned n_threads) {
+    
+    Board board;
+    for (int i = 0; i < n; ++i) {
+        if (i % 3 == 0) board.AddAParticle(i, "red");
+        else board.AddBParticle(2 * i, 0.5);
+    }
+    
+    Simulation simulation(board, [](const int* current, int* next, size_t first, size_t last, uint64_t tick) {
+        for (size_t i = first; i < last; ++i)
+            next[i] = current[i] + static_cast<int>(mix_position(current[i] ^ static_cast<int>(tick)) % 5) - 2;
+    }, n_threads);
+    
+    const int ticks = 10;
+    auto start = std::chrono::steady_clock::now();
+    simulation.run(ticks);
+    double time = seconds_since(start);
+    
+    Simulation::TickStats sum = {0, 0, 0, 0, 0, 0};
+    for (const auto& x : simulation.Stats()) {
+        sum.update += x.update;
+        sum.exclusivity += x.exclusivity;
+        sum.collisions += x.collisions;
+        sum.total += x.total;
+    }
+    std::cerr << "Simulation x " << n << " on " << n_threads << " threads: " << time << " s for " << ticks << " ticks; per tick update " << sum.update / ticks << " s, exclusivity " << sum.exclusivity / ticks << " s, collisions " << sum.collisions / ticks << " s, total " << sum.total / ticks << " s" << std::endl;
+}
+
+
+
+/** Compares scanning, copying and printing n particles stored as Things behind virtual calls against the same particles stored in a VariantBoard
+ @param n is the number of particles
+ */
+void benchmark_variant_board(int n) {
+    
+    Board things;
+    VariantBoard variants;
+    for (int i = 0; i < n; ++i) {
+        if (i % 2 == 0) {
+            things.AddAParticle(i % 1000, "red");
+            variants.AddAParticle(i % 1000, "red");
         }
-        return false;
+        else {
+            things.AddBParticle(n + i, 0.5);
+            variants.AddBParticle(n + i, 0.5);
+        }
+    }
+    
+    // Positions() visits every particle once, through a virtual call or a std::visit
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i)
+        things.Positions();
+    double things_scan = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i)
+        variants.Positions();
+    double variants_scan = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    {
+        Board copy(things);
     }
+    double things_copy = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    {
+        VariantBoard copy(variants);
+    }
+    double variants_copy = seconds_since(start);
+    
+    std::ofstream fout("/dev/null");
+    start = std::chrono::steady_clock::now();
+    fout << things;
+    double things_print = seconds_since(start);
+    
+    start = std::chrono::steady_clock::now();
+    fout << variants;
+    double variants_print = seconds_since(start);
+    
+    std::cerr << "Things vs variants x " << n << ": scan " << things_scan << " / " << variants_scan << " s, copy " << things_copy << " / " << variants_copy << " s, print " << things_print << " / " << variants_print << " s" << std::endl;
+}
+
+
+
+/** Times removing a particle by rebuilding the Board through its copy constructor, as was done before Board could remove particles, against swap-erase removal under constant churn
+ @param n is the number of particles on the Board
+ */
+void benchmark_removal(int n) {
+    
+    Board board;
+    for (int i = 0; i < n; ++i)
+        board.AddBParticle(i, 0.5);
+    
+    // the old way: every removal clones the whole Board
+    const int rebuilds = 8;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rebuilds; ++r) {
+        Board rebuilt(board);
+    }
+    double rebuild_time = seconds_since(start) / rebuilds;
+    
+    // churn: empty a position, then add a particle back at it
+    const int rounds = 1 << 18;
+    size_t allocations = heap_allocations;
+    size_t blocks = ThingPool::blocks_allocated;
+    uint32_t seed = 12345;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        seed = seed * 1664525u + 1013904223u;
+        int pos = static_cast<int>(seed % static_cast<uint32_t>(n));
+        board.RemoveParticlesAt(pos);
+        board.AddBParticle(pos, 0.5);
+    }
+    double churn_time = seconds_since(start) / rounds;
+    
+    std::cerr << "Remove one of " << n << ": rebuild " << rebuild_time << " s, swap-erase and re-add " << churn_time << " s, " << heap_allocations - allocations << " allocations and " << ThingPool::blocks_allocated - blocks << " pool blocks over " << rounds << " rounds" << std::endl;
 }
+#endif
@@ -4,18 +4,126 @@
  @author Douglas Yao
  @date 1/19/2016
 
-Converts two user-inputted numbers into binary, then performs bitwise addition and multiplication on the numbers and outputs the values. Also compares the two numbers and outputs whether one is greater than, less than, or equal to the other.
+Converts two user-inputted numbers of any length into binary, then performs bitwise addition and multiplication on the numbers and outputs the values. Also compares the two numbers and outputs whether one is greater than, less than, or equal to the other.
 
 */
 
 #include <iostream>
 #include <vector>
-#include <math.h>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <system_error>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+ /** @class LimbStorage
+ @brief Growable array of 64-bit limbs that keeps up to two limbs inside the object itself
+
+Values of up to 128 bits need no heap memory at all, so an array of small Integers is one dense block. The array moves to the heap only when it needs more than two limbs, and then grows like a std::vector.
+
+ */
+
+class LimbStorage {
+public:
+
+	typedef uint64_t Limb;
+	static const size_t INLINE_LIMBS = 2;
+
+	LimbStorage() : count(0), room(INLINE_LIMBS) {}
+	LimbStorage(const LimbStorage& other);
+	LimbStorage(LimbStorage&& other) noexcept;
+	LimbStorage& operator=(const LimbStorage& other);
+	LimbStorage& operator=(LimbStorage&& other) noexcept;
+	~LimbStorage();
+
+	Limb* data() {return room > INLINE_LIMBS ? heap : local;}
+	const Limb* data() const {return room > INLINE_LIMBS ? heap : local;}
+	Limb* begin() {return data();}
+	Limb* end() {return data() + count;}
+	const Limb* begin() const {return data();}
+	const Limb* end() const {return data() + count;}
+	Limb& operator[](size_t i) {return data()[i];}
+	const Limb& operator[](size_t i) const {return data()[i];}
+	Limb back() const {return data()[count - 1];}
+
+	size_t size() const {return count;}
+	size_t capacity() const {return room;}
+	bool empty() const {return count == 0;}
+
+	void reserve(size_t n);
+	void resize(size_t n, Limb value = 0);
+	void assign(size_t n, Limb value);
+	void assign(const Limb* first, const Limb* last);
+	void push_back(Limb x);
+	void pop_back() {--count;}
+	void clear() {count = 0;}
+
+	bool operator==(const LimbStorage& rhs) const;
+
+private:
+
+	void grow(size_t n);
+
+	union {
+		Limb local[INLINE_LIMBS]; // in use while room is INLINE_LIMBS
+		Limb* heap; // in use once room is larger
+	};
+	uint32_t count; // limbs in use
+	uint32_t room; // limbs available without growing
+};
+
+
+
+ /** @class FixedInteger
+ @brief Stores an integer of at most LIMBS 64-bit limbs in a fixed array, with construction, arithmetic and comparisons usable in constant expressions
+
+Meant for constants such as powers, masks and lookup tables, which can then be computed by the compiler and placed in read-only data rather than built at startup. Arithmetic whose result does not fit throws std::overflow_error, which in a constant expression is a compile error. An Integer can be constructed from a FixedInteger and back.
+
+ */
+
+class Integer;
+
+template <size_t LIMBS>
+class FixedInteger {
+public:
+
+	constexpr FixedInteger() : limb(), count(0) {}
+	constexpr FixedInteger(uint64_t initial);
+	explicit FixedInteger(const Integer& x);
+
+	constexpr FixedInteger& operator+=(const FixedInteger& rhs);
+	constexpr FixedInteger& operator*=(const FixedInteger& rhs);
+	constexpr bool operator<(const FixedInteger& rhs) const;
+	constexpr bool operator==(const FixedInteger& rhs) const;
+
+	constexpr const uint64_t* data() const {return limb;}
+	constexpr size_t size() const {return count;}
+
+private:
+
+	static constexpr uint64_t multiply_add_limb(uint64_t x, uint64_t y, uint64_t a, uint64_t b, uint64_t* high);
+
+	uint64_t limb[LIMBS]; // least significant first; those at count and above are zero
+	size_t count; // limbs in use, with no leading zero limbs
+};
+
+
 
  /** @class Integer
- @brief Stores an integer value using bits
+ @brief Stores an integer value using 64-bit limbs
 
-This class is designed to mimic the int data type
+This class is designed to mimic the int data type. The value is kept as an array of 64-bit words, least significant first, with no leading zero words, so zero has no words at all. Values of up to 128 bits are stored inside the object; see LimbStorage.
 
  */
 
@@ -23,42 +131,273 @@ class Integer {
 public:
 
 	Integer();
-	Integer(unsigned int new_a);
+	Integer(unsigned int initial);
+	explicit Integer(const std::string& digits, unsigned int base = 10);
+	template <size_t LIMBS> Integer(const FixedInteger<LIMBS>& fixed);
 
 	Integer& operator+=(const Integer& rhs);
 	Integer& operator*=(const Integer& rhs);
+	Integer& operator/=(const Integer& rhs);
+	Integer& operator%=(const Integer& rhs);
 	bool operator<(const Integer& rhs) const;
 	bool operator==(const Integer& rhs) const;
 
-	void print_as_int()  const;
+	void print_as_int(std::ostream& out = std::cout) const;
 	void print_as_bits() const;
+	std::string to_decimal() const;
+	size_t bit_length() const;
+
+	static void divide(const Integer& dividend, const Integer& divisor, Integer& quotient, Integer& remainder);
+
+	static size_t karatsuba_threshold; // limbs in the shorter operand from which Karatsuba replaces schoolbook multiplication
+	static size_t ntt_threshold; // limbs in the shorter operand from which the number-theoretic transform takes over
+	static size_t threads; // threads a multiplication may use
+	static size_t parallel_threshold; // limbs in the shorter operand from which, with more than one thread, the transform is used and split across the threads
+
+	friend Integer operator+(const Integer& lhs, const Integer& rhs);
+	friend Integer operator*(const Integer& lhs, const Integer& rhs);
+	friend class Montgomery;
+	friend class IntegerBatch;
+	template <size_t LIMBS> friend class FixedInteger;
+
+private:
+
+	typedef LimbStorage::Limb Limb;
+	static const int LIMB_BITS = 64;
+
+	static const size_t DECIMAL_CHUNK = 19; // decimal digits that always fit in a limb
+	static const size_t DECIMAL_BASE_LIMBS = 32; // limbs below which decimal conversion works a limb at a time rather than dividing and conquering
+
+	bool test_bit(size_t i) const;
+	void trim();
+	void multiply_add(Limb factor, Limb addend);
+	void parse_decimal(const char* digits, size_t n);
+	void write_decimal(size_t level, size_t width, std::string& out) const;
+
+	static const Integer& decimal_power(size_t level);
+	static void divide_limbs(const Integer& u, const Integer& v, Integer& quotient, Integer& remainder);
+	static Limb divide_small(Limb* x, size_t n, Limb divisor);
+
+	static Limb* scratch(size_t n);
+	static size_t multiply_scratch(size_t nx, size_t ny);
+	static size_t karatsuba_scratch(size_t n);
+	static size_t ntt_length(size_t nx, size_t ny);
+	static bool use_ntt(size_t n);
+	static void multiply(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out, Limb* work);
+	static void multiply_schoolbook(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out);
+	static void multiply_karatsuba(const Limb* x, const Limb* y, size_t n, Limb* out, Limb* work);
+	static void multiply_ntt(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out, Limb* work);
+	static Limb add_limbs(Limb* dst, size_t nd, const Limb* src, size_t ns);
+	static Limb sub_limbs(Limb* dst, size_t nd, const Limb* src, size_t ns);
+
+	LimbStorage limb;
+};
+
+/** @class Montgomery
+ @brief Multiplies and exponentiates modulo one odd modulus without dividing
+
+Values are kept in Montgomery form, x * R mod N with R = 2^(64 n) for an n-limb modulus N, so the product of two of them needs only a reduction by R, which is a shift, instead of a division by N. Converting into and out of the form costs one Montgomery product each, so the context pays off over many products, as in modular exponentiation.
+
+ */
+
+class Montgomery {
+public:
+
+	explicit Montgomery(const Integer& modulus);
+
+	Integer to_montgomery(const Integer& x) const;
+	Integer from_montgomery(const Integer& x) const;
+	Integer multiply(const Integer& x, const Integer& y) const;
+	Integer power(const Integer& base, const Integer& exponent) const;
+	const Integer& modulus() const {return n;}
+
+private:
+
+	typedef Integer::Limb Limb;
+	static const int WINDOW_BITS = 4; // exponent bits handled per table lookup in power
+
+	void multiply(const Limb* x, const Limb* y, Limb* out) const;
+	void load(const Integer& x, Limb* out) const;
+	Integer store(const Limb* x) const;
+
+	Integer n; // the modulus
+	size_t size; // limbs in the modulus
+	Limb n_prime; // -1 / N mod 2^64
+	Integer r_squared; // R^2 mod N, which takes a value into Montgomery form
+};
+
+/** @class IntegerBatch
+ @brief Holds many Integers of one fixed width side by side so that they can be added, compared and multiplied by a small factor together
+
+The values are stored limb-major: row i holds limb i of every value, so one vector register loads the same limb of four (AVX2) or two (SSE4.2) neighbouring values and their carries travel together. Arithmetic wraps modulo 2^(64 width), like an unsigned machine word. The kernel is chosen from the processor's features at run time, and the scalar kernel is always available.
+
+ */
+
+class IntegerBatch {
+public:
+
+	enum Kernel {SCALAR, SSE42, AVX2};
+
+	IntegerBatch(size_t width, size_t lanes);
+
+	void set(size_t lane, const Integer& x);
+	Integer get(size_t lane) const;
+	size_t width() const {return rows;}
+	size_t lanes() const {return count;}
+
+	void add(const IntegerBatch& rhs);
+	void multiply_small(uint32_t factor);
+	void less(const IntegerBatch& rhs, unsigned char* out) const;
+
+	static Kernel best_kernel();
+	static Kernel kernel; // kernel the batch operations use; one the processor lacks falls back to best_kernel()
+
+private:
+
+	typedef Integer::Limb Limb;
+
+	void check_shape(const IntegerBatch& rhs) const;
+	static Kernel active_kernel();
+
+	std::vector<Limb> limb; // limb i of value j is at i * count + j
+	size_t rows; // limbs per value
+	size_t count; // values in the batch
+};
+
+/** @class WorkerPool
+ @brief Threads that stay alive from one parallel region to the next, so a multiplication starts its threads once per program rather than once per stage
+
+One region runs at a time. A region asked for while another runs, from a task of the running region or from a second thread multiplying at the same time, runs all of its workers on the calling thread instead of adding threads, so the machine is never oversubscribed.
+
+ */
+
+class WorkerPool {
+public:
+
+	static WorkerPool& shared();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+	~WorkerPool();
+
+	void run(size_t workers, const std::function<void(size_t)>& task);
 
 private:
 
-	std::vector<bool> bit;
-	unsigned int a;
+	WorkerPool() : busy(false), task(nullptr), helpers(0), generation(0), running(0), stopping(false) {}
+	void work(size_t number);
+
+	std::atomic<bool> busy; // set while a region runs
+	std::vector<std::thread> threads; // thread i runs worker i + 1
+	std::mutex mutex;
+	std::condition_variable start_region;
+	std::condition_variable end_region;
+	const std::function<void(size_t)>* task; // task of the current region
+	size_t helpers; // threads taking part in the current region
+	uint64_t generation; // number of regions started
+	size_t running; // threads of the current region not finished yet
+	std::exception_ptr failure; // first exception thrown by a thread during the current region
+	bool stopping;
 };
 
-Integer operator+(Integer lhs, const Integer& rhs);
-Integer operator*(Integer lhs, const Integer& rhs);
+unsigned char add_with_carry(unsigned char carry, uint64_t x, uint64_t y, uint64_t* sum);
+unsigned char sub_with_borrow(unsigned char borrow, uint64_t x, uint64_t y, uint64_t* difference);
+uint64_t multiply_wide(uint64_t x, uint64_t y, uint64_t* high);
+uint64_t multiply_add_wide(uint64_t x, uint64_t y, uint64_t a, uint64_t b, uint64_t* high);
+uint64_t divide_wide(uint64_t high, uint64_t low, uint64_t divisor, uint64_t* remainder);
+int leading_zeros(uint64_t x);
+void run_workers(size_t workers, const std::function<void(size_t)>& task);
+
+void batch_add_scalar(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, size_t first);
+void batch_multiply_small_scalar(uint64_t* x, uint32_t factor, size_t rows, size_t lanes, size_t first);
+void batch_less_scalar(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, size_t first, unsigned char* out);
+#if defined(__GNUC__) && defined(__x86_64__)
+__attribute__((target("sse4.2"))) void batch_add_sse42(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes);
+__attribute__((target("sse4.2"))) void batch_multiply_small_sse42(uint64_t* x, uint32_t factor, size_t rows, size_t lanes);
+__attribute__((target("sse4.2"))) void batch_less_sse42(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, unsigned char* out);
+__attribute__((target("avx2"))) void batch_add_avx2(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes);
+__attribute__((target("avx2"))) void batch_multiply_small_avx2(uint64_t* x, uint32_t factor, size_t rows, size_t lanes);
+__attribute__((target("avx2"))) void batch_less_avx2(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, unsigned char* out);
+#endif
+
+// 10^i for every i whose power fits in a limb
+static const uint64_t POWERS_OF_TEN[20] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL};
+
+size_t Integer::karatsuba_threshold = 32;
+size_t Integer::ntt_threshold = 1 << 15;
+size_t Integer::threads = std::max(1u, std::thread::hardware_concurrency());
+size_t Integer::parallel_threshold = 1 << 14;
+static const size_t DECIMAL_TABLE_LIMBS = 32; // limbs in the compile-time table of decimal powers, enough for (10^19)^32
+IntegerBatch::Kernel IntegerBatch::kernel = IntegerBatch::AVX2;
+
+Integer operator+(const Integer& lhs, const Integer& rhs);
+Integer operator*(const Integer& lhs, const Integer& rhs);
+Integer operator/(const Integer& lhs, const Integer& rhs);
+Integer operator%(const Integer& lhs, const Integer& rhs);
 bool operator!=(const Integer& lhs, const Integer& rhs);
 bool operator>(const Integer& lhs, const Integer& rhs);
 bool operator<=(const Integer& lhs, const Integer& rhs);
 bool operator>=(const Integer& lhs, const Integer& rhs);
+template <size_t LIMBS> constexpr FixedInteger<LIMBS> operator+(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+template <size_t LIMBS> constexpr FixedInteger<LIMBS> operator*(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+template <size_t LIMBS> constexpr bool operator!=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+template <size_t LIMBS> constexpr bool operator>(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+template <size_t LIMBS> constexpr bool operator<=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+template <size_t LIMBS> constexpr bool operator>=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs);
+
+#ifdef INTEGER_BENCHMARK
+void benchmark_addition(int bits);
+void benchmark_multiplication(size_t bits);
+void benchmark_allocations(size_t bits);
+void benchmark_small_integers(int n);
+void benchmark_decimal(size_t digits);
+void benchmark_modular_power(size_t bits);
+void benchmark_batch(size_t lanes);
+void benchmark_fixed_powers();
+void benchmark_parallel_multiplication(size_t bits);
 
+int main() {
+	for (int bits = 64; bits <= 1 << 16; bits *= 8)
+		benchmark_addition(bits);
+	for (size_t bits = 1 << 9; bits <= 1 << 22; bits *= 2)
+		benchmark_multiplication(bits);
+	for (size_t bits = 64; bits <= 1 << 20; bits *= 32)
+		benchmark_allocations(bits);
+	for (int n = 1 << 12; n <= 1 << 20; n *= 16)
+		benchmark_small_integers(n);
+	for (size_t digits = 1000; digits <= 1000000; digits *= 10)
+		benchmark_decimal(digits);
+	for (size_t bits = 256; bits <= 4096; bits *= 2)
+		benchmark_modular_power(bits);
+	for (size_t lanes = 1 << 10; lanes <= 1 << 18; lanes *= 16)
+		benchmark_batch(lanes);
+	benchmark_fixed_powers();
+	for (size_t bits = 1 << 22; bits <= 1 << 24; bits *= 4)
+		benchmark_parallel_multiplication(bits);
+	return 0;
+}
+#else
 int main() {
 
-	unsigned int uint_value;
-	std::cout << "Please input an integer a: ";
-	std::cin >> uint_value;
-	Integer a = uint_value; // Create Integer type with input value
+	std::string digits;
+	Integer a, b;
 
-	std::cout << "The base-2 represenation of a is: "; a.print_as_bits();
-	std::cout << std::endl;
+	try {
+		std::cout << "Please input an integer a: ";
+		std::cin >> digits;
+		a = Integer(digits); // Create Integer type with input value
 
-	std::cout << "Please input an integer b: ";
-	std::cin >> uint_value;
-	Integer b = uint_value; // Create Integer type with input value
+		std::cout << "The base-2 represenation of a is: "; a.print_as_bits();
+		std::cout << std::endl;
+
+		std::cout << "Please input an integer b: ";
+		std::cin >> digits;
+		b = Integer(digits); // Create Integer type with input value
+	}
+	catch (std::invalid_argument& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 
 	std::cout << "The base-2 represenation of b is: "; b.print_as_bits();
 	std::cout << std::endl;
@@ -81,349 +420,3063 @@ int main() {
 
 	return 0;
 }
+#endif
 
 
 
-/** default constructor for Integer class
+/** copy constructor for LimbStorage class. Copies into the inline limbs when they are enough.
+
+@param other is the array to be copied
 
 */
 
-Integer::Integer() {
-	bit.push_back(0);
+LimbStorage::LimbStorage(const LimbStorage& other) : count(0), room(INLINE_LIMBS) {
+	assign(other.begin(), other.end());
 }
 
 
 
-/** non-default constructor for Integer class. Stores inputted integer as bits in a vector of bools.
+/** move constructor for LimbStorage class. Takes over the heap limbs of another array, or copies its inline limbs, and leaves it empty.
 
-@param initial is the user-inputted integer
+@param other is the array to be moved from
 
 */
 
-Integer::Integer(unsigned int initial) {
-
-	a = initial;
+LimbStorage::LimbStorage(LimbStorage&& other) noexcept : count(other.count), room(other.room) {
 
-	// input is 0
-	if (initial == 0) bit.push_back(0);
+	if (other.room > INLINE_LIMBS) heap = other.heap;
+	else std::copy(other.local, other.local + other.count, local);
 
-	// input is at least 1
-	while (initial > 0) {
-		bit.push_back(initial % 2);
-		initial /= 2;
-	}
+	other.count = 0;
+	other.room = INLINE_LIMBS;
 }
 
 
 
-/** performs bitwise addition between two Integers and sets the first Integer to the sum
+/** copy assignment for LimbStorage class. Reuses the limbs already held when they are enough.
 
-@param rhs is the Integer to be added to the Integer that calls the function
-@return the Integer that called the function with the rhs Integer added to it
+@param other is the array to be copied
+@return the array
 
 */
 
-Integer& Integer::operator+=(const Integer& rhs) {
+LimbStorage& LimbStorage::operator=(const LimbStorage& other) {
+	if (this != &other)
+		assign(other.begin(), other.end());
+	return *this;
+}
 
-	// if one Integer has more bits than the other, then 0s must be added to the smaller of the two so they have the same amount of bits. Copies of both Integers are made for this reason.
-	Integer copy_1 = *this;
-	Integer copy_2 = rhs;
 
-	int i = 0;
-	int carry_over = 0;
 
-	// performs bitwise addition until the smaller of the two Integer has no more bits to add
-	while (i < rhs.bit.size() && i < bit.size()) {
+/** move assignment for LimbStorage class
 
-		int new_number = rhs.bit[i] + bit[i] + carry_over;
+@param other is the array to be moved from
+@return the array
 
-		// if the sum of the bits and carry-over are 2 or greater
-		if (new_number > 1) {
-			bit[i] = (new_number - 2);
-			carry_over = 1;
-		}
+*/
 
-		// if the sum is less than 2
-		else {
-			bit[i] = (new_number);
-			carry_over = 0;
-		}
-		++i;
+LimbStorage& LimbStorage::operator=(LimbStorage&& other) noexcept {
+
+	if (this != &other) {
+		if (room > INLINE_LIMBS)
+			delete[] heap;
+
+		count = other.count;
+		room = other.room;
+		if (other.room > INLINE_LIMBS) heap = other.heap;
+		else std::copy(other.local, other.local + other.count, local);
+
+		other.count = 0;
+		other.room = INLINE_LIMBS;
 	}
+	return *this;
+}
 
-	// depending on whether the right-side or left-side Integer has more bits, 0s are added to the beginning of the smaller Integer so that addition can continue
 
-	// if the rhs Integer has more bits than the object Integer
-	if (rhs.bit.size() > bit.size()) {
 
-		while (i < rhs.bit.size()) {
+/** destructor for LimbStorage class
 
-			copy_1.bit.push_back(0);
-			int new_number = rhs.bit[i] + copy_1.bit[i] + carry_over;
+*/
 
-			if (new_number > 1) {
-				bit.push_back(new_number - 2);
-				carry_over = 1;
-			}
+LimbStorage::~LimbStorage() {
+	if (room > INLINE_LIMBS)
+		delete[] heap;
+}
 
-			else {
-				bit.push_back(new_number);
-				carry_over = 0;
-			}
-			++i;
-		}
 
-		// if carry over is 1 after the final bits have been added, an additional 1 is added to the beginning of the binary value
-		if (carry_over == 1)
-			bit.push_back(1);
-	}
 
-	// if the rhs Integer has less bits than the object Integer
-	if (rhs.bit.size() < bit.size()) {
+/** moves the limbs to a heap array with room for exactly n limbs
 
-		while (i < bit.size()) {
+@param n is the new room, more than the current room
 
-			copy_2.bit.push_back(0);
-			int new_number = copy_2.bit[i] + bit[i] + carry_over;
+*/
 
-			if (new_number > 1) {
-				bit[i] = (new_number - 2);
-				carry_over = 1;
-			}
+void LimbStorage::grow(size_t n) {
 
-			else {
-				bit[i] = (new_number);
-				carry_over = 0;
-			}
-			++i;
-		}
+	Limb* bigger = new Limb[n];
+	std::copy(begin(), end(), bigger);
+	if (room > INLINE_LIMBS)
+		delete[] heap;
 
-		if (carry_over == 1)
-			bit.push_back(1);
-	}
+	heap = bigger;
+	room = static_cast<uint32_t>(n);
+}
 
-	// if the rhs Integer has the same amount of bits and the object Integer
-	if (rhs.bit.size() == bit.size()) {
 
-		if (carry_over == 1)
-			bit.push_back(1);
-	}
 
-	return *this;
+/** makes room for at least n limbs
+
+@param n is the number of limbs
+
+*/
+
+void LimbStorage::reserve(size_t n) {
+	if (n > room)
+		grow(n);
 }
 
 
 
-/** performs bitwise multiplication between two Integers and sets the first Integer to the product. Assumes that plus_equals is defined.
+/** changes the number of limbs, filling new ones with a value
 
-@param rhs is the Integer that the Integer that calls the function will be multiplied by
-@return the Integer that called the function with the rhs Integer multiplied by it
+@param n is the new number of limbs
+@param value is the value of the new limbs
 
 */
 
-Integer& Integer::operator*=(const Integer& rhs) {
+void LimbStorage::resize(size_t n, Limb value) {
 
-	Integer add = *this;
-	Integer temp = *this;
-	int n = rhs.a;
+	reserve(n);
+	if (n > count)
+		std::fill(data() + count, data() + n, value);
+	count = static_cast<uint32_t>(n);
+}
 
-	// adds the object Integer to itself and repeats this process x times, where x is the value of the rhs Integer
-	for (int i = 0; i < n - 1; ++i) {
-		temp += (add);
-	}
 
-	*this = temp;
-	return *this;
+
+/** replaces the limbs with n copies of a value
+
+@param n is the new number of limbs
+@param value is the value of every limb
+
+*/
+
+void LimbStorage::assign(size_t n, Limb value) {
+
+	reserve(n);
+	std::fill(data(), data() + n, value);
+	count = static_cast<uint32_t>(n);
 }
 
 
 
-/** compares two Integers and returns true if the left hand Integer is less than the right hand Integer
+/** replaces the limbs with a copy of another array's
 
-@param rhs is the right hand Integer
-@return true if the left hand Integer is less than the right hand Integer
+@param first is the first limb to copy, not inside this array
+@param last is one past the last limb to copy
 
 */
 
-bool Integer::operator<(const Integer& rhs) const {
+void LimbStorage::assign(const Limb* first, const Limb* last) {
 
-	Integer lhs = *this;
+	size_t n = last - first;
+	if (n > room) {
 
-	// if the left Integer has less bits than the right Integer, it is smaller
-	if (lhs.bit.size() < rhs.bit.size()) {
-		return true;
+		// the old limbs are thrown away, so there is nothing to copy over
+		count = 0;
+		grow(n);
 	}
+	std::copy(first, last, data());
+	count = static_cast<uint32_t>(n);
+}
 
-	// if the left Integer has more bits than the right Integer, it is not smaller
-	if (lhs.bit.size() > rhs.bit.size()) {
-		return false;
-	}
 
-	// if the two Integers have the same amount of bits, their bits are compared one by one, starting from the most significant bit
-	if (lhs.bit.size() == rhs.bit.size()) {
 
-		int n = lhs.bit.size();
-		for (int i = 0; i < n; ++i) {
+/** appends one limb, doubling the room when it runs out
 
-			if (lhs.bit[n - 1 - i] < rhs.bit[n - 1 - i])
-				return true;
+@param x is the limb
 
-			if (lhs.bit[n - 1 - i] > rhs.bit[n - 1 - i])
-				return false;
+*/
 
-		}
-	}
-	return false;
+void LimbStorage::push_back(Limb x) {
+
+	if (count == room)
+		grow(2 * room);
+	data()[count++] = x;
 }
 
 
 
-/** compares two Integers and returns true if the two Integers are equal
+/** compares two arrays limb by limb
 
-@param rhs is the right hand Integer
-@return true if the two Integers are equal
+@param rhs is the right hand array
+@return true if both hold the same limbs
 
 */
 
-bool Integer::operator==(const Integer& rhs) const {
+bool LimbStorage::operator==(const LimbStorage& rhs) const {
+	return count == rhs.count && std::equal(begin(), end(), rhs.begin());
+}
 
-	Integer lhs = *this;
 
-	// if the two Integers have different amounts of bits, they are not equal
-	if (lhs.bit.size() != rhs.bit.size())
-		return false;
 
-	// if the two Integers have the same amount of bits, their bits are compared one by one
-	if (lhs.bit.size() == rhs.bit.size()) {
+/** constructor for FixedInteger class. Stores a value of one limb.
 
-		int n = lhs.bit.size();
-		for (int i = 0; i < n; ++i) {
+@param initial is the value
 
-			// if any two bits are not equal, then the Integers are not equal
-			if (lhs.bit[i] != rhs.bit[i])
-				return false;
-		}
+*/
+
+template <size_t LIMBS>
+constexpr FixedInteger<LIMBS>::FixedInteger(uint64_t initial) : limb(), count(0) {
+
+	static_assert(LIMBS > 0, "a FixedInteger needs at least one limb");
+	// zero is stored with no limbs at all
+	if (initial > 0) {
+		limb[0] = initial;
+		count = 1;
 	}
-	return true;
 }
 
 
 
-/** prints out the value of the Integer in bits
+/** constructs a FixedInteger from an Integer
+
+@param x is the Integer to copy
+@throws std::invalid_argument if x needs more than LIMBS limbs
 
 */
 
-void Integer::print_as_bits() const {
+template <size_t LIMBS>
+FixedInteger<LIMBS>::FixedInteger(const Integer& x) : limb(), count(x.limb.size()) {
 
-	std::cout << "(";
+	if (count > LIMBS)
+		throw std::invalid_argument("Integer is wider than the FixedInteger");
+	std::copy(x.limb.begin(), x.limb.end(), limb);
+}
 
-	for (size_t i = 0, n = bit.size(); i < n; ++i) {
-		std::cout << bit[n - 1 - i]; // reverses the order of the bits, since they were added to the vector in reverse order
-	}
 
-	std::cout << ")_2";
 
+/** multiplies two words and adds two more with plain 64-bit arithmetic, in four 32-bit partial products, since neither the processor's wide multiply nor __int128 is available in every constant expression
+
+@param x is the first factor
+@param y is the second factor
+@param a is the first word added
+@param b is the second word added
+@param high is set to the high 64 bits of the result
+@return the low 64 bits of the result
+
+*/
+
+template <size_t LIMBS>
+constexpr uint64_t FixedInteger<LIMBS>::multiply_add_limb(uint64_t x, uint64_t y, uint64_t a, uint64_t b, uint64_t* high) {
+
+	uint64_t x0 = x & 0xFFFFFFFFu, x1 = x >> 32, y0 = y & 0xFFFFFFFFu, y1 = y >> 32;
+	uint64_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+	uint64_t middle = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu);
+	uint64_t low = (middle << 32) | (p00 & 0xFFFFFFFFu);
+	uint64_t top = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+
+	low += a;
+	top += low < a;
+	low += b;
+	top += low < b;
+	*high = top;
+	return low;
 }
 
 
 
-/** prints out the value of the Integer as a decimal number
+/** adds another FixedInteger to this one
+
+@param rhs is the FixedInteger to be added
+@return this FixedInteger with rhs added to it
+@throws std::overflow_error if the sum needs more than LIMBS limbs, leaving this FixedInteger unchanged
 
 */
 
-void Integer::print_as_int() const {
+template <size_t LIMBS>
+constexpr FixedInteger<LIMBS>& FixedInteger<LIMBS>::operator+=(const FixedInteger& rhs) {
+
+	// the sum goes to a local array first, so that an overflow leaves this FixedInteger as it was
+	size_t n = count > rhs.count ? count : rhs.count;
+	uint64_t sum[LIMBS] = {};
+	uint64_t carry = 0;
+	for (size_t i = 0; i < n; ++i) {
+		sum[i] = limb[i] + carry;
+		carry = sum[i] < carry;
+		sum[i] += rhs.limb[i];
+		carry += sum[i] < rhs.limb[i];
+	}
+	if (carry) {
+		if (n == LIMBS)
+			throw std::overflow_error("FixedInteger: sum does not fit");
+		sum[n++] = 1;
+	}
+
+	count = n;
+	for (size_t i = 0; i < LIMBS; ++i)
+		limb[i] = sum[i];
+	return *this;
+}
+
+
 
-	int temp = 0;
+/** multiplies this FixedInteger by another with schoolbook multiplication
 
-	// converts the binary value of the Integer into the decimal value
-	for (int i = 0; i < bit.size(); ++i) {
-		temp += bit[i] * pow(2, i);
+@param rhs is the FixedInteger to multiply by
+@return this FixedInteger multiplied by rhs
+@throws std::overflow_error if the product needs more than LIMBS limbs
+
+*/
+
+template <size_t LIMBS>
+constexpr FixedInteger<LIMBS>& FixedInteger<LIMBS>::operator*=(const FixedInteger& rhs) {
+
+	if (count == 0 || rhs.count == 0) {
+		*this = FixedInteger();
+		return *this;
+	}
+	// the product has at least count + rhs.count - 1 limbs
+	if (count + rhs.count > LIMBS + 1)
+		throw std::overflow_error("FixedInteger: product does not fit");
+
+	uint64_t product[LIMBS] = {};
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t carry = 0;
+		for (size_t j = 0; j < rhs.count; ++j)
+			product[i + j] = multiply_add_limb(limb[i], rhs.limb[j], product[i + j], carry, &carry);
+		if (carry) {
+			if (i + rhs.count == LIMBS)
+				throw std::overflow_error("FixedInteger: product does not fit");
+			product[i + rhs.count] = carry;
+		}
 	}
 
-	std::cout << temp;
+	count = count + rhs.count < LIMBS ? count + rhs.count : LIMBS;
+	for (size_t i = 0; i < LIMBS; ++i)
+		limb[i] = product[i];
+	while (count > 0 && limb[count - 1] == 0)
+		--count;
+	return *this;
 }
 
 
 
-/** performs bitwise addition of two Integers and returns the sum. Assumes that += is defined.
+/** compares two FixedIntegers, from the most significant limb down
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return the sum of the two Integers
+@param rhs is the right hand FixedInteger
+@return true if this FixedInteger is less than rhs
 
 */
 
-Integer operator+(Integer lhs, const Integer& rhs) {
-	return lhs += rhs;
+template <size_t LIMBS>
+constexpr bool FixedInteger<LIMBS>::operator<(const FixedInteger& rhs) const {
+
+	if (count != rhs.count)
+		return count < rhs.count;
+	for (size_t i = count; i-- > 0; ) {
+		if (limb[i] != rhs.limb[i])
+			return limb[i] < rhs.limb[i];
+	}
+	return false;
 }
 
 
 
-/** performs bitwise multiplication of two Integers and returns the product. Assumes that *= is defined.
+/** checks two FixedIntegers for equality
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return the product of the two Integers
+@param rhs is the right hand FixedInteger
+@return true if both hold the same value
 
 */
 
-Integer operator*(Integer lhs, const Integer& rhs) {
-	return lhs *= rhs;
+template <size_t LIMBS>
+constexpr bool FixedInteger<LIMBS>::operator==(const FixedInteger& rhs) const {
+
+	if (count != rhs.count)
+		return false;
+	for (size_t i = 0; i < count; ++i) {
+		if (limb[i] != rhs.limb[i])
+			return false;
+	}
+	return true;
 }
 
 
 
-/** compares two Integers and returns if they are not equal. Assumes that == is defined.
+/** adds two FixedIntegers
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return true if the Integers are not equal
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return the sum
 
 */
 
-bool operator!=(const Integer& lhs, const Integer& rhs) {
+template <size_t LIMBS>
+constexpr FixedInteger<LIMBS> operator+(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
+	FixedInteger<LIMBS> sum = lhs;
+	sum += rhs;
+	return sum;
+}
+
+
+
+/** multiplies two FixedIntegers
+
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return the product
+
+*/
+
+template <size_t LIMBS>
+constexpr FixedInteger<LIMBS> operator*(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
+	FixedInteger<LIMBS> product = lhs;
+	product *= rhs;
+	return product;
+}
+
+
+
+/** checks two FixedIntegers for inequality
+
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return true if they differ
+
+*/
+
+template <size_t LIMBS>
+constexpr bool operator!=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
 	return !(lhs == rhs);
 }
 
 
 
-/** compares two Integers and returns if the left hand Integer is greater than the right hand Integer. Assumes that < is defined.
+/** checks whether one FixedInteger is greater than another
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return true if the left hand Integer is greater than the right hand Integer
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return true if lhs is greater than rhs
 
 */
 
-bool operator>(const Integer& lhs, const Integer& rhs) {
-	return (rhs < lhs);
+template <size_t LIMBS>
+constexpr bool operator>(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
+	return rhs < lhs;
 }
 
 
 
-/** compares two Integers and returns if the left hand Integer is less than or equal to the right hand Integer. Assumes that > is defined.
+/** checks whether one FixedInteger is less than or equal to another
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return true if the left hand Integer is less than or equal to the right hand Integer
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return true if lhs is at most rhs
 
 */
 
-bool operator<=(const Integer& lhs, const Integer& rhs) {
-	return !(lhs > rhs);
+template <size_t LIMBS>
+constexpr bool operator<=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
+	return !(rhs < lhs);
 }
 
 
 
-/** compares two Integers and returns if the left hand Integer is greater than or equal to the right hand Integer. Assumes that < is defined.
+/** checks whether one FixedInteger is greater than or equal to another
 
-@param lhs is the left hand Integer
-@param rhs is the right hand Integer
-@return true if the left hand Integer is greater than or equal to the right hand Integer
+@param lhs is the left hand FixedInteger
+@param rhs is the right hand FixedInteger
+@return true if lhs is at least rhs
 
 */
 
-bool operator>=(const Integer& lhs, const Integer& rhs) {
+template <size_t LIMBS>
+constexpr bool operator>=(const FixedInteger<LIMBS>& lhs, const FixedInteger<LIMBS>& rhs) {
 	return !(lhs < rhs);
 }
 
+
+
+/** computes (10^DECIMAL_CHUNK)^(2^level), the divisor Integer::decimal_power returns for a level, in a constant expression
+
+@param level is the number of squarings
+@return the power
+
+*/
+
+constexpr FixedInteger<DECIMAL_TABLE_LIMBS> fixed_decimal_power(size_t level) {
+	FixedInteger<DECIMAL_TABLE_LIMBS> power = 10000000000000000000ULL; // 10^DECIMAL_CHUNK
+	for (size_t i = 0; i < level; ++i)
+		power *= power;
+	return power;
+}
+
+// the first levels of Integer::decimal_power, computed by the compiler
+static constexpr FixedInteger<DECIMAL_TABLE_LIMBS> DECIMAL_POWER_TABLE[] = {fixed_decimal_power(0), fixed_decimal_power(1), fixed_decimal_power(2), fixed_decimal_power(3), fixed_decimal_power(4), fixed_decimal_power(5)};
+
+
+
+/** default constructor for Integer class
+
+*/
+
+Integer::Integer() {}
+
+
+
+/** non-default constructor for Integer class. Stores inputted integer in a single limb.
+
+@param initial is the user-inputted integer
+
+*/
+
+Integer::Integer(unsigned int initial) {
+
+	// zero is stored with no limbs at all
+	if (initial > 0) limb.push_back(initial);
+}
+
+
+
+/** constructs an Integer from a FixedInteger, which may have been computed at compile time
+
+@param fixed is the value to copy
+
+*/
+
+template <size_t LIMBS>
+Integer::Integer(const FixedInteger<LIMBS>& fixed) {
+	limb.assign(fixed.data(), fixed.data() + fixed.size());
+}
+
+
+
+/** constructs an Integer from a string of decimal or binary digits of any length. Decimal strings are converted by Integer::parse_decimal.
+
+@param digits are the digits, most significant first
+@param base is 10 or 2
+@throws std::invalid_argument if the base is not supported, there are no digits or a character is not a digit of the base
+
+*/
+
+Integer::Integer(const std::string& digits, unsigned int base) {
+
+	if (base != 2 && base != 10)
+		throw std::invalid_argument("Integer: base " + std::to_string(base) + " is not supported");
+	if (digits.empty())
+		throw std::invalid_argument("Integer: no digits");
+
+	for (char c : digits) {
+		if (c < '0' || c >= static_cast<char>('0' + base))
+			throw std::invalid_argument("Integer: '" + digits + "' is not a base " + std::to_string(base) + " number");
+	}
+
+	size_t n = digits.size();
+
+	// each binary digit is a bit, counted from the end of the string
+	if (base == 2) {
+		limb.assign((n + LIMB_BITS - 1) / LIMB_BITS, 0);
+		for (size_t i = 0; i < n; ++i) {
+			if (digits[n - 1 - i] == '1')
+				limb[i / LIMB_BITS] |= Limb(1) << (i % LIMB_BITS);
+		}
+		trim();
+		return;
+	}
+
+	parse_decimal(digits.data(), n);
+}
+
+
+
+/** sets the Integer to the value of a string of decimal digits. Short strings are taken 19 digits at a time, the most that fit in a limb; longer ones are split so the low part has 19 * 2^k digits, and the two halves are converted separately and joined by one multiplication by 10^(19 * 2^k).
+
+@param digits are the digits, most significant first, already checked
+@param n is the number of digits
+
+*/
+
+void Integer::parse_decimal(const char* digits, size_t n) {
+
+	limb.clear();
+
+	if (n <= DECIMAL_CHUNK * DECIMAL_BASE_LIMBS) {
+
+		// the first chunk takes the leftover digits, so every later chunk has exactly 19
+		limb.reserve(n / DECIMAL_CHUNK + 1);
+		for (size_t i = 0, chunk = n % DECIMAL_CHUNK ? n % DECIMAL_CHUNK : DECIMAL_CHUNK; i < n; i += chunk, chunk = DECIMAL_CHUNK) {
+			Limb value = 0;
+			for (size_t j = i; j < i + chunk; ++j)
+				value = value * 10 + (digits[j] - '0');
+			multiply_add(POWERS_OF_TEN[chunk], value);
+		}
+		return;
+	}
+
+	// the largest 19 * 2^level below n, which leaves the high part no longer than the low part
+	size_t level = 0;
+	while (DECIMAL_CHUNK << (level + 1) < n)
+		++level;
+	size_t low_digits = DECIMAL_CHUNK << level;
+
+	Integer low;
+	low.parse_decimal(digits + n - low_digits, low_digits);
+	parse_decimal(digits, n - low_digits);
+	*this *= decimal_power(level);
+	*this += low;
+}
+
+
+
+/** returns 10^(19 * 2^level), computing the powers by repeated squaring the first time they are needed. The powers are kept for later conversions.
+
+@param level is the level
+@return the power
+
+*/
+
+const Integer& Integer::decimal_power(size_t level) {
+
+	// a deque never moves its elements, so references handed out stay valid as it grows
+	static std::mutex lock;
+	static std::deque<Integer> powers;
+	std::lock_guard<std::mutex> guard(lock);
+
+	// the first levels are copied from the table the compiler built, the rest squared at run time
+	const size_t table_levels = sizeof(DECIMAL_POWER_TABLE) / sizeof(DECIMAL_POWER_TABLE[0]);
+	while (powers.size() <= level && powers.size() < table_levels)
+		powers.push_back(Integer(DECIMAL_POWER_TABLE[powers.size()]));
+	while (powers.size() <= level)
+		powers.push_back(powers.back() * powers.back());
+	return powers[level];
+}
+
+
+
+/** multiplies the Integer by one limb and adds another, in place
+
+@param factor is the limb multiplied by
+@param addend is the limb added
+
+*/
+
+void Integer::multiply_add(Limb factor, Limb addend) {
+
+	Limb carry = addend;
+	for (auto& x : limb) {
+		Limb high;
+		Limb low = multiply_wide(x, factor, &high);
+		high += add_with_carry(0, low, carry, &low);
+		x = low;
+		carry = high;
+	}
+	if (carry) limb.push_back(carry);
+	trim(); // a zero factor leaves zero limbs behind
+}
+
+
+
+/** adds two words and an incoming carry, using the processor's add-with-carry instruction where one is available
+
+@param carry is the incoming carry, 0 or 1
+@param x is the first word
+@param y is the second word
+@param sum is set to the low 64 bits of the sum
+@return the outgoing carry
+
+*/
+
+unsigned char add_with_carry(unsigned char carry, uint64_t x, uint64_t y, uint64_t* sum) {
+
+#if defined(__x86_64__) || defined(_M_X64)
+	unsigned long long out;
+	carry = _addcarry_u64(carry, x, y, &out);
+	*sum = out;
+	return carry;
+#else
+	uint64_t s = x + y;
+	unsigned char c = s < x;
+	s += carry;
+	c |= s < carry;
+	*sum = s;
+	return c;
+#endif
+}
+
+
+
+/** performs addition between two Integers one limb at a time and sets the first Integer to the sum
+
+@param rhs is the Integer to be added to the Integer that calls the function
+@return the Integer that called the function with the rhs Integer added to it
+
+*/
+
+Integer& Integer::operator+=(const Integer& rhs) {
+
+	size_t n = rhs.limb.size();
+
+	// the sum has at least as many limbs as the longer Integer, and one more if the top limb carries; when the limbs must grow anyway, room for both is made at once
+	if (limb.size() < n) {
+		if (limb.capacity() < n) limb.reserve(n + 1);
+		limb.resize(n, 0);
+	}
+
+	unsigned char carry = 0;
+	size_t i = 0;
+
+	// adds the limbs the two Integers have in common
+	for (; i < n; ++i)
+		carry = add_with_carry(carry, limb[i], rhs.limb[i], &limb[i]);
+
+	// carries into the remaining limbs of the longer Integer until the carry dies out
+	for (size_t m = limb.size(); carry && i < m; ++i)
+		carry = add_with_carry(carry, limb[i], 0, &limb[i]);
+
+	// if carry over is 1 after the final limbs have been added, an additional limb is needed
+	if (carry)
+		limb.push_back(1);
+
+	return *this;
+}
+
+
+
+/** subtracts two words and an incoming borrow, using the processor's subtract-with-borrow instruction where one is available
+
+@param borrow is the incoming borrow, 0 or 1
+@param x is the word subtracted from
+@param y is the word subtracted
+@param difference is set to the low 64 bits of the difference
+@return the outgoing borrow
+
+*/
+
+unsigned char sub_with_borrow(unsigned char borrow, uint64_t x, uint64_t y, uint64_t* difference) {
+
+#if defined(__x86_64__) || defined(_M_X64)
+	unsigned long long out;
+	borrow = _subborrow_u64(borrow, x, y, &out);
+	*difference = out;
+	return borrow;
+#else
+	uint64_t d = x - y;
+	unsigned char b = x < y;
+	b |= d < borrow;
+	*difference = d - borrow;
+	return b;
+#endif
+}
+
+
+
+/** multiplies two words into a 128-bit product
+
+@param x is the first word
+@param y is the second word
+@param high is set to the high 64 bits of the product
+@return the low 64 bits of the product
+
+*/
+
+uint64_t multiply_wide(uint64_t x, uint64_t y, uint64_t* high) {
+
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = static_cast<unsigned __int128>(x) * y;
+	*high = static_cast<uint64_t>(product >> 64);
+	return static_cast<uint64_t>(product);
+#else
+	// four 32-bit partial products
+	uint64_t x0 = x & 0xFFFFFFFFu, x1 = x >> 32, y0 = y & 0xFFFFFFFFu, y1 = y >> 32;
+	uint64_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+	uint64_t middle = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu);
+	*high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+	return (middle << 32) | (p00 & 0xFFFFFFFFu);
+#endif
+}
+
+
+
+/** multiplies two words and adds two more, which always fits in 128 bits
+
+@param x is the first factor
+@param y is the second factor
+@param a is the first word added
+@param b is the second word added
+@param high is set to the high 64 bits of the result
+@return the low 64 bits of the result
+
+*/
+
+uint64_t multiply_add_wide(uint64_t x, uint64_t y, uint64_t a, uint64_t b, uint64_t* high) {
+
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 result = static_cast<unsigned __int128>(x) * y + a + b;
+	*high = static_cast<uint64_t>(result >> 64);
+	return static_cast<uint64_t>(result);
+#else
+	uint64_t low = multiply_wide(x, y, high);
+	*high += add_with_carry(0, low, a, &low);
+	*high += add_with_carry(0, low, b, &low);
+	return low;
+#endif
+}
+
+
+
+/** multiplies two Integers and sets the first Integer to the product. Small operands use schoolbook multiplication, larger ones Karatsuba and the largest a number-theoretic transform; see Integer::multiply.
+
+@param rhs is the Integer that the Integer that calls the function will be multiplied by
+@return the Integer that called the function with the rhs Integer multiplied by it
+
+*/
+
+Integer& Integer::operator*=(const Integer& rhs) {
+
+	// anything times zero is zero
+	if (limb.empty() || rhs.limb.empty()) {
+		limb.clear();
+		return *this;
+	}
+
+	// the product is built in scratch space, since both operands are read until the end, and then copied over the old limbs
+	size_t nx = limb.size(), ny = rhs.limb.size();
+	Limb* product = scratch(nx + ny + multiply_scratch(nx, ny));
+	multiply(limb.data(), nx, rhs.limb.data(), ny, product, product + nx + ny);
+
+	// trimmed before copying, so a product that fits in the limbs already held needs no more
+	size_t n = nx + ny;
+	while (product[n - 1] == 0)
+		--n;
+	limb.assign(product, product + n);
+	return *this;
+}
+
+
+
+/** returns this thread's scratch space for multiplication, growing it if needed. It is kept between calls, so once it is large enough multiplying allocates nothing but the result.
+
+@param n is the number of limbs needed
+@return the scratch space
+
+*/
+
+Integer::Limb* Integer::scratch(size_t n) {
+
+	static thread_local std::vector<Limb> buffer;
+	if (buffer.size() < n)
+		buffer.resize(n);
+	return buffer.data();
+}
+
+
+
+/** returns the number of limbs of scratch space that Integer::multiply needs, following the same choice of algorithm
+
+@param nx is the number of limbs in the first operand
+@param ny is the number of limbs in the second operand
+@return the number of limbs
+
+*/
+
+size_t Integer::multiply_scratch(size_t nx, size_t ny) {
+
+	if (nx < ny) std::swap(nx, ny);
+
+	if (ny == 0 || ny < karatsuba_threshold) return 0;
+	if (use_ntt(ny)) return 2 * ntt_length(nx, ny) + ntt_length(nx, ny) / 2;
+	if (nx == ny) return karatsuba_scratch(ny);
+
+	// a partial product, then whatever the full and the last, shorter pieces need
+	return 2 * ny + std::max(multiply_scratch(ny, ny), multiply_scratch(ny, nx % ny));
+}
+
+
+
+/** returns the number of limbs of scratch space that Integer::multiply_karatsuba needs
+
+@param n is the number of limbs in each operand
+@return the number of limbs
+
+*/
+
+size_t Integer::karatsuba_scratch(size_t n) {
+
+	if (n < karatsuba_threshold || n < 4) return 0;
+
+	// the two half sums and their product, then the space of the recursive call on the half sums
+	size_t k = n - n / 2;
+	return 4 * k + 4 + karatsuba_scratch(k + 1);
+}
+
+
+
+/** drops leading zero limbs, so that equal values always have identical limbs
+
+*/
+
+void Integer::trim() {
+	while (!limb.empty() && limb.back() == 0)
+		limb.pop_back();
+}
+
+
+
+/** adds one limb array into another in place
+
+@param dst is the array added to
+@param nd is the number of limbs in dst
+@param src is the array added, with ns <= nd
+@param ns is the number of limbs in src
+@return the carry out of the top limb of dst
+
+*/
+
+Integer::Limb Integer::add_limbs(Limb* dst, size_t nd, const Limb* src, size_t ns) {
+
+	unsigned char carry = 0;
+	size_t i = 0;
+	for (; i < ns; ++i)
+		carry = add_with_carry(carry, dst[i], src[i], &dst[i]);
+	for (; carry && i < nd; ++i)
+		carry = add_with_carry(carry, dst[i], 0, &dst[i]);
+	return carry;
+}
+
+
+
+/** subtracts one limb array from another in place
+
+@param dst is the array subtracted from
+@param nd is the number of limbs in dst
+@param src is the array subtracted, with ns <= nd
+@param ns is the number of limbs in src
+@return the borrow out of the top limb of dst
+
+*/
+
+Integer::Limb Integer::sub_limbs(Limb* dst, size_t nd, const Limb* src, size_t ns) {
+
+	unsigned char borrow = 0;
+	size_t i = 0;
+	for (; i < ns; ++i)
+		borrow = sub_with_borrow(borrow, dst[i], src[i], &dst[i]);
+	for (; borrow && i < nd; ++i)
+		borrow = sub_with_borrow(borrow, dst[i], 0, &dst[i]);
+	return borrow;
+}
+
+
+
+/** multiplies two limb arrays, picking the algorithm from the length of the shorter one. Karatsuba needs operands of equal length, so a longer operand is cut into pieces as long as the shorter one.
+
+@param x is the first array
+@param nx is the number of limbs in x
+@param y is the second array
+@param ny is the number of limbs in y
+@param out receives all nx + ny limbs of the product
+@param work is scratch space of multiply_scratch(nx, ny) limbs
+
+*/
+
+void Integer::multiply(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out, Limb* work) {
+
+	// makes x the longer operand
+	if (nx < ny) {
+		std::swap(x, y);
+		std::swap(nx, ny);
+	}
+
+	if (ny < karatsuba_threshold) {
+		multiply_schoolbook(x, nx, y, ny, out);
+		return;
+	}
+	if (use_ntt(ny)) {
+		multiply_ntt(x, nx, y, ny, out, work);
+		return;
+	}
+	if (nx == ny) {
+		multiply_karatsuba(x, y, ny, out, work);
+		return;
+	}
+
+	// multiplies y by each ny-limb piece of x and adds the partial products at their offsets
+	std::fill(out, out + nx + ny, 0);
+	Limb* partial = work;
+	for (size_t i = 0; i < nx; i += ny) {
+		size_t piece = std::min(ny, nx - i);
+		multiply(x + i, piece, y, ny, partial, work + 2 * ny);
+		add_limbs(out + i, nx + ny - i, partial, piece + ny);
+	}
+}
+
+
+
+/** multiplies two limb arrays one limb of y at a time
+
+@param x is the first array
+@param nx is the number of limbs in x
+@param y is the second array
+@param ny is the number of limbs in y
+@param out receives all nx + ny limbs of the product
+
+*/
+
+void Integer::multiply_schoolbook(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out) {
+
+	std::fill(out, out + nx + ny, 0);
+
+	for (size_t i = 0; i < ny; ++i) {
+		Limb carry = 0;
+		for (size_t j = 0; j < nx; ++j)
+			out[i + j] = multiply_add_wide(x[j], y[i], out[i + j], carry, &carry);
+		out[i + nx] = carry;
+	}
+}
+
+
+
+/** multiplies two limb arrays of equal length with Karatsuba's method: three half-length products instead of four
+
+@param x is the first array
+@param y is the second array
+@param n is the number of limbs in each
+@param out receives all 2n limbs of the product
+@param work is scratch space of karatsuba_scratch(n) limbs
+
+*/
+
+void Integer::multiply_karatsuba(const Limb* x, const Limb* y, size_t n, Limb* out, Limb* work) {
+
+	// below 4 limbs the half-length products would not get any shorter
+	if (n < karatsuba_threshold || n < 4) {
+		multiply_schoolbook(x, n, y, n, out);
+		return;
+	}
+
+	// x = x1 * B^h + x0 and y = y1 * B^h + y0, with the high halves the longer
+	size_t h = n / 2, k = n - h;
+
+	multiply_karatsuba(x, y, h, out, work); // x0 * y0 goes in the low 2h limbs
+	multiply_karatsuba(x + h, y + h, k, out + 2 * h, work); // x1 * y1 goes in the high 2k limbs
+
+	// (x0 + x1) * (y0 + y1), which has k + 1 limbs per factor
+	Limb* sx = work;
+	Limb* sy = sx + k + 1;
+	Limb* middle = sy + k + 1;
+	std::copy(x + h, x + n, sx);
+	std::copy(y + h, y + n, sy);
+	sx[k] = add_limbs(sx, k, x, h);
+	sy[k] = add_limbs(sy, k, y, h);
+	multiply_karatsuba(sx, sy, k + 1, middle, middle + 2 * k + 2);
+
+	// x0 * y1 + x1 * y0 is what remains after taking off the other two products
+	sub_limbs(middle, 2 * k + 2, out, 2 * h);
+	sub_limbs(middle, 2 * k + 2, out + 2 * h, 2 * k);
+
+	// the cross term has at most n + 1 significant limbs, and those always fit above out + h
+	size_t m = 2 * k + 2;
+	while (m > 0 && middle[m - 1] == 0)
+		--m;
+	add_limbs(out + h, 2 * n - h, middle, m);
+}
+
+
+
+// the transform works modulo the prime 2^64 - 2^32 + 1, whose multiplicative group has order divisible by 2^32 and is generated by 7
+static const uint64_t NTT_PRIME = 0xFFFFFFFF00000001ULL;
+static const uint64_t NTT_GENERATOR = 7;
+static const int NTT_DIGIT_BITS = 16; // the convolution of 16-bit digits stays below the prime for up to 2^31 digits
+
+
+
+/** multiplies two residues modulo NTT_PRIME, reducing with 2^64 = 2^32 - 1 and 2^96 = -1
+
+@param x is the first residue
+@param y is the second residue
+@return the product
+
+*/
+
+uint64_t ntt_multiply(uint64_t x, uint64_t y) {
+
+	uint64_t high;
+	uint64_t low = multiply_wide(x, y, &high);
+	uint64_t high_high = high >> 32, high_low = high & 0xFFFFFFFFu;
+
+	uint64_t t;
+	if (sub_with_borrow(0, low, high_high, &t)) t -= 0xFFFFFFFFu; // wrapped by 2^64, which is 2^32 - 1 too much
+	uint64_t r;
+	if (add_with_carry(0, t, high_low * 0xFFFFFFFFu, &r)) r += 0xFFFFFFFFu;
+	return r >= NTT_PRIME ? r - NTT_PRIME : r;
+}
+
+
+
+/** raises a residue to a power modulo NTT_PRIME
+
+@param base is the residue
+@param exponent is the power
+@return the result
+
+*/
+
+uint64_t ntt_power(uint64_t base, uint64_t exponent) {
+
+	uint64_t result = 1;
+	for (; exponent > 0; exponent >>= 1) {
+		if (exponent & 1) result = ntt_multiply(result, base);
+		base = ntt_multiply(base, base);
+	}
+	return result;
+}
+
+
+
+/** returns the pool that every multiplication shares, starting it on first use
+
+@return the pool
+
+*/
+
+WorkerPool& WorkerPool::shared() {
+	static WorkerPool pool;
+	return pool;
+}
+
+
+
+/** stops and joins the threads of the pool
+
+*/
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_region.notify_all();
+	for (auto& x : threads)
+		x.join();
+}
+
+
+
+/** loop of one thread of the pool: waits for a region that needs it, runs its worker of the region, and reports back. An exception from the task is kept for run to rethrow.
+
+@param number is the worker the thread runs in every region, from 1
+
+*/
+
+void WorkerPool::work(size_t number) {
+
+	uint64_t seen = 0;
+	for (;;) {
+		const std::function<void(size_t)>* region_task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			start_region.wait(lock, [&]() {return stopping || (generation != seen && number <= helpers);});
+			if (stopping) return;
+			seen = generation;
+			region_task = task;
+		}
+
+		std::exception_ptr error;
+		try {
+			(*region_task)(number);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (error && !failure)
+			failure = error;
+		if (--running == 0)
+			end_region.notify_one();
+	}
+}
+
+
+
+/** runs a task once for each of several workers and waits for all of them. The calling thread runs worker 0 and the pool's threads the others, the pool starting threads as it first needs them; workers left without a thread, because none could be started or because another region is running, run on the calling thread.
+
+@param workers is the number of workers, at least one
+@param task is called with the index of each worker, from 0 to workers - 1
+@throws the first exception any of the calls threw, once every call has finished
+
+*/
+
+void WorkerPool::run(size_t workers, const std::function<void(size_t)>& task) {
+
+	if (workers <= 1 || busy.exchange(true)) {
+		for (size_t t = 0; t < workers; ++t)
+			task(t);
+		return;
+	}
+
+	try {
+		while (threads.size() + 1 < workers)
+			threads.emplace_back(&WorkerPool::work, this, threads.size() + 1);
+	}
+	catch (const std::system_error&) {}
+
+	size_t used = std::min(workers - 1, threads.size());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		helpers = running = used;
+		++generation;
+	}
+	start_region.notify_all();
+
+	std::exception_ptr error;
+	try {
+		for (size_t t = 0; t < workers; t = (t == 0 ? used + 1 : t + 1))
+			task(t);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		end_region.wait(lock, [&]() {return running == 0;});
+		if (!error)
+			error = failure;
+		failure = nullptr;
+		helpers = 0;
+	}
+	busy = false;
+	if (error)
+		std::rethrow_exception(error);
+}
+
+
+
+/** runs a task once for each of several workers on the shared WorkerPool and waits for all of them
+
+@param workers is the number of workers, at least one
+@param task is called with the index of each worker, from 0 to workers - 1
+
+*/
+
+void run_workers(size_t workers, const std::function<void(size_t)>& task) {
+	WorkerPool::shared().run(workers, task);
+}
+
+
+
+/** performs a range of the butterflies of one stage of the transform. A stage of length len pairs a[i + j] with a[i + j + len / 2] for every block i and every j below len / 2; butterfly b is the one with j = b mod len / 2 in block b / (len / 2).
+
+@param a is the array
+@param n is the length of the array
+@param len is the length of the blocks in this stage
+@param roots holds n / 2 powers of the root of unity
+@param first is the first butterfly to perform
+@param last is one past the last butterfly to perform
+
+*/
+
+void ntt_stage(uint64_t* a, size_t n, size_t len, const uint64_t* roots, size_t first, size_t last) {
+
+	size_t half = len / 2, stride = n / len;
+	for (size_t b = first; b < last; ) {
+		size_t i = b / half * len, j = b % half;
+		size_t end = std::min(half, j + (last - b));
+		for (; j < end; ++j, ++b) {
+			uint64_t u = a[i + j];
+			uint64_t v = ntt_multiply(a[i + j + half], roots[j * stride]);
+			uint64_t sum = u + v; // both are below the prime, which is above 2^63, so the sum may wrap
+			a[i + j] = (sum < u || sum >= NTT_PRIME) ? sum - NTT_PRIME : sum;
+			a[i + j + half] = u >= v ? u - v : u + (NTT_PRIME - v);
+		}
+	}
+}
+
+
+
+/** transforms an array in place with an iterative radix-2 number-theoretic transform. With several threads every worker takes an equal, contiguous share of the butterflies of each stage. While the blocks are no longer than a share, every worker stays within its own blocks and runs those stages without waiting for the others; each longer stage ends with the workers joining.
+
+@param a is the array
+@param n is the length of the array, a power of two
+@param inverse is true for the inverse transform, which also divides by the length
+@param roots is scratch space for n / 2 powers of the root of unity
+@param threads is the number of threads to use
+
+*/
+
+void ntt_transform(uint64_t* a, size_t n, bool inverse, uint64_t* roots, size_t threads) {
+
+	// a power of two, so that the shares line up with the blocks
+	size_t workers = 1;
+	while (workers * 2 <= threads && workers * 4 <= n)
+		workers *= 2;
+	size_t share = n / 2 / workers; // butterflies per worker in every stage
+
+	// bit-reversal permutation
+	for (size_t i = 1, j = 0; i < n; ++i) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) std::swap(a[i], a[j]);
+	}
+
+	// powers of a primitive n-th root of unity, shared by every stage
+	uint64_t root = ntt_power(NTT_GENERATOR, (NTT_PRIME - 1) / n);
+	if (inverse) root = ntt_power(root, NTT_PRIME - 2);
+	run_workers(workers, [&](size_t t) {
+		uint64_t power = ntt_power(root, t * share);
+		for (size_t i = t * share; i < (t + 1) * share; ++i) {
+			roots[i] = power;
+			power = ntt_multiply(power, root);
+		}
+	});
+
+	// the stages whose blocks fit in one share
+	run_workers(workers, [&](size_t t) {
+		for (size_t len = 2; len <= 2 * share; len <<= 1)
+			ntt_stage(a, n, len, roots, t * share, (t + 1) * share);
+	});
+
+	// the longer stages, whose butterflies pair elements of different shares
+	for (size_t len = std::max<size_t>(2, 4 * share); len <= n; len <<= 1)
+		run_workers(workers, [&](size_t t) {ntt_stage(a, n, len, roots, t * share, (t + 1) * share);});
+
+	if (inverse) {
+		uint64_t scale = ntt_power(n, NTT_PRIME - 2);
+		run_workers(workers, [&](size_t t) {
+			for (size_t i = 2 * t * share; i < 2 * (t + 1) * share; ++i)
+				a[i] = ntt_multiply(a[i], scale);
+		});
+	}
+}
+
+
+
+/** returns the length of the transform that Integer::multiply_ntt uses: the number of digits in the product, rounded up to a power of two
+
+@param nx is the number of limbs in the first operand
+@param ny is the number of limbs in the second operand
+@return the length
+
+*/
+
+size_t Integer::ntt_length(size_t nx, size_t ny) {
+
+	size_t n = 1;
+	while (n < LIMB_BITS / NTT_DIGIT_BITS * (nx + ny))
+		n <<= 1;
+	return n;
+}
+
+
+
+/** returns whether Integer::multiply uses the number-theoretic transform for a product: always from ntt_threshold limbs, and already from parallel_threshold limbs when it can be split across threads
+
+@param n is the number of limbs in the shorter operand
+@return true if the product uses the transform
+
+*/
+
+bool Integer::use_ntt(size_t n) {
+	return n >= ntt_threshold || (threads > 1 && n >= parallel_threshold);
+}
+
+
+
+/** multiplies two limb arrays by convolving their 16-bit digits with a number-theoretic transform, split across Integer::threads threads when the shorter operand has at least parallel_threshold limbs
+
+@param x is the first array
+@param nx is the number of limbs in x
+@param y is the second array
+@param ny is the number of limbs in y
+@param out receives all nx + ny limbs of the product
+@param work is scratch space of 5 / 2 * ntt_length(nx, ny) limbs
+
+*/
+
+void Integer::multiply_ntt(const Limb* x, size_t nx, const Limb* y, size_t ny, Limb* out, Limb* work) {
+
+	const int per_limb = LIMB_BITS / NTT_DIGIT_BITS;
+	const Limb digit_mask = (Limb(1) << NTT_DIGIT_BITS) - 1;
+	size_t n = ntt_length(nx, ny);
+
+	// large products are split across threads
+	size_t workers = std::min(nx, ny) >= parallel_threshold ? std::max<size_t>(1, std::min(threads, nx + ny)) : 1;
+
+	// splits both operands into digits, every worker a contiguous range of whole limbs
+	uint64_t* fx = work;
+	uint64_t* fy = work + n;
+	uint64_t* roots = work + 2 * n;
+	size_t limbs = n / per_limb;
+	run_workers(workers, [&](size_t t) {
+		for (size_t i = t * limbs / workers * per_limb; i < (t + 1) * limbs / workers * per_limb; ++i) {
+			size_t j = i / per_limb, shift = i % per_limb * NTT_DIGIT_BITS;
+			fx[i] = j < nx ? (x[j] >> shift) & digit_mask : 0;
+			fy[i] = j < ny ? (y[j] >> shift) & digit_mask : 0;
+		}
+	});
+
+	ntt_transform(fx, n, false, roots, workers);
+	ntt_transform(fy, n, false, roots, workers);
+	run_workers(workers, [&](size_t t) {
+		for (size_t i = t * n / workers; i < (t + 1) * n / workers; ++i)
+			fx[i] = ntt_multiply(fx[i], fy[i]);
+	});
+	ntt_transform(fx, n, true, roots, workers);
+
+	// each coefficient is below 2^63, so the carry into the next digit fits in a word. Every worker carries through its own limbs starting from zero; the carries out of the ranges are then added in one after another, and rarely travel past a limb.
+	std::vector<uint64_t> carries(workers);
+	run_workers(workers, [&](size_t t) {
+		size_t first = t * (nx + ny) / workers, last = (t + 1) * (nx + ny) / workers;
+		uint64_t carry = 0;
+		for (size_t j = first; j < last; ++j) {
+			Limb limb = 0;
+			for (int k = 0; k < per_limb; ++k) {
+				uint64_t value = fx[j * per_limb + k] + carry;
+				limb |= (value & digit_mask) << (k * NTT_DIGIT_BITS);
+				carry = value >> NTT_DIGIT_BITS;
+			}
+			out[j] = limb;
+		}
+		carries[t] = carry;
+	});
+	for (size_t t = 0; t + 1 < workers; ++t) {
+		size_t last = (t + 1) * (nx + ny) / workers;
+		add_limbs(out + last, nx + ny - last, &carries[t], 1);
+	}
+}
+
+
+
+/** divides a 128-bit number by a word, using the processor's 128-by-64-bit division where one is available
+
+@param high is the high word of the dividend, below the divisor so the quotient fits in a word
+@param low is the low word of the dividend
+@param divisor is the divisor
+@param remainder is set to the remainder
+@return the quotient
+
+*/
+
+uint64_t divide_wide(uint64_t high, uint64_t low, uint64_t divisor, uint64_t* remainder) {
+
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 dividend = (static_cast<unsigned __int128>(high) << 64) | low;
+	*remainder = static_cast<uint64_t>(dividend % divisor);
+	return static_cast<uint64_t>(dividend / divisor);
+#else
+	// one quotient bit at a time; the running remainder stays below the divisor
+	uint64_t quotient = 0;
+	for (int i = 63; i >= 0; --i) {
+		bool overflow = high >> 63;
+		high = (high << 1) | ((low >> i) & 1);
+		quotient <<= 1;
+		if (overflow || high >= divisor) {
+			high -= divisor;
+			quotient |= 1;
+		}
+	}
+	*remainder = high;
+	return quotient;
+#endif
+}
+
+
+
+/** counts the zero bits above the highest set bit of a word
+
+@param x is the word, not zero
+@return the number of leading zero bits
+
+*/
+
+int leading_zeros(uint64_t x) {
+
+#if defined(__GNUC__)
+	return __builtin_clzll(x);
+#else
+	int n = 0;
+	for (; !(x >> 63); x <<= 1)
+		++n;
+	return n;
+#endif
+}
+
+
+
+/** divides a limb array by one limb in place
+
+@param x is the array, replaced by the quotient
+@param n is the number of limbs in x
+@param divisor is the limb divided by, not zero
+@return the remainder
+
+*/
+
+Integer::Limb Integer::divide_small(Limb* x, size_t n, Limb divisor) {
+
+	Limb remainder = 0;
+	for (size_t i = n; i-- > 0; )
+		x[i] = divide_wide(remainder, x[i], divisor, &remainder);
+	return remainder;
+}
+
+
+
+/** divides one Integer by another, giving both the quotient and the remainder
+
+@param dividend is the Integer divided
+@param divisor is the Integer divided by
+@param quotient is set to the quotient, rounded down
+@param remainder is set to the remainder; it may be the same object as any of the others but quotient
+@throws std::domain_error if the divisor is zero
+
+*/
+
+void Integer::divide(const Integer& dividend, const Integer& divisor, Integer& quotient, Integer& remainder) {
+
+	if (divisor.limb.empty())
+		throw std::domain_error("Integer: division by zero");
+
+	// divide_limbs writes its results while still reading its operands
+	if (&quotient == &dividend || &quotient == &divisor || &remainder == &dividend || &remainder == &divisor) {
+		Integer q, r;
+		divide_limbs(dividend, divisor, q, r);
+		quotient = std::move(q);
+		remainder = std::move(r);
+		return;
+	}
+	divide_limbs(dividend, divisor, quotient, remainder);
+}
+
+
+
+/** divides the Integer by another and keeps the quotient
+
+@param rhs is the Integer divided by
+@return the Integer that called the function, divided by rhs and rounded down
+@throws std::domain_error if rhs is zero
+
+*/
+
+Integer& Integer::operator/=(const Integer& rhs) {
+
+	Integer remainder;
+	divide(*this, rhs, *this, remainder);
+	return *this;
+}
+
+
+
+/** divides the Integer by another and keeps the remainder
+
+@param rhs is the Integer divided by
+@return the Integer that called the function, reduced modulo rhs
+@throws std::domain_error if rhs is zero
+
+*/
+
+Integer& Integer::operator%=(const Integer& rhs) {
+
+	// nothing to do when the Integer is already below rhs
+	if (rhs.limb.empty())
+		throw std::domain_error("Integer: division by zero");
+	if (*this < rhs)
+		return *this;
+
+	Integer quotient;
+	divide(*this, rhs, quotient, *this);
+	return *this;
+}
+
+
+
+/** divides one Integer by another with Knuth's algorithm D (The Art of Computer Programming, vol. 2, 4.3.1). Both are shifted so the divisor's top limb has its high bit set; each quotient limb is then estimated from the top two limbs of the running remainder, corrected at most twice, and its multiple of the divisor subtracted.
+
+@param u is the dividend
+@param v is the divisor, not zero
+@param quotient is set to the quotient, must not be u or v
+@param remainder is set to the remainder, must not be u or v
+
+*/
+
+void Integer::divide_limbs(const Integer& u, const Integer& v, Integer& quotient, Integer& remainder) {
+
+	if (u < v) {
+		quotient.limb.clear();
+		remainder.limb = u.limb;
+		return;
+	}
+
+	size_t n = v.limb.size(), m = u.limb.size() - n;
+
+	if (n == 1) {
+		quotient.limb = u.limb;
+		Limb r = divide_small(quotient.limb.data(), quotient.limb.size(), v.limb[0]);
+		quotient.trim();
+		remainder.limb.clear();
+		if (r) remainder.limb.push_back(r);
+		return;
+	}
+
+	// normalized copies: vn has n limbs, un one more limb than u
+	int shift = leading_zeros(v.limb[n - 1]);
+	Limb* vn = scratch(2 * n + m + 1);
+	Limb* un = vn + n;
+	for (size_t i = n; i-- > 0; )
+		vn[i] = shift ? (v.limb[i] << shift) | (i > 0 ? v.limb[i - 1] >> (LIMB_BITS - shift) : 0) : v.limb[i];
+	un[m + n] = shift ? u.limb[m + n - 1] >> (LIMB_BITS - shift) : 0;
+	for (size_t i = m + n; i-- > 0; )
+		un[i] = shift ? (u.limb[i] << shift) | (i > 0 ? u.limb[i - 1] >> (LIMB_BITS - shift) : 0) : u.limb[i];
+
+	quotient.limb.assign(m + 1, 0);
+	for (size_t j = m + 1; j-- > 0; ) {
+
+		// estimates the quotient limb from the top two limbs; the running remainder is below vn, so un[j + n] <= vn[n - 1]
+		Limb qhat, rhat;
+		bool rhat_overflow = false;
+		if (un[j + n] == vn[n - 1]) {
+			qhat = ~Limb(0);
+			rhat_overflow = add_with_carry(0, un[j + n - 1], vn[n - 1], &rhat);
+		}
+		else {
+			qhat = divide_wide(un[j + n], un[j + n - 1], vn[n - 1], &rhat);
+		}
+
+		// the estimate is at most two too large; the next limb of each side decides
+		while (!rhat_overflow) {
+			Limb high;
+			Limb low = multiply_wide(qhat, vn[n - 2], &high);
+			if (high < rhat || (high == rhat && low <= un[j + n - 2]))
+				break;
+			--qhat;
+			rhat_overflow = add_with_carry(0, rhat, vn[n - 1], &rhat);
+		}
+
+		// subtracts qhat * vn from the running remainder
+		Limb carry = 0;
+		unsigned char borrow = 0;
+		for (size_t i = 0; i < n; ++i) {
+			Limb high;
+			Limb low = multiply_wide(qhat, vn[i], &high);
+			high += add_with_carry(0, low, carry, &low);
+			carry = high;
+			borrow = sub_with_borrow(borrow, un[i + j], low, &un[i + j]);
+		}
+		borrow = sub_with_borrow(borrow, un[j + n], carry, &un[j + n]);
+
+		// the estimate was one too large after all, so one vn is added back
+		if (borrow) {
+			--qhat;
+			un[j + n] += add_limbs(un + j, n, vn, n);
+		}
+		quotient.limb[j] = qhat;
+	}
+	quotient.trim();
+
+	// the remainder is what is left of un, shifted back
+	remainder.limb.assign(n, 0);
+	for (size_t i = 0; i < n; ++i)
+		remainder.limb[i] = shift ? (un[i] >> shift) | (un[i + 1] << (LIMB_BITS - shift)) : un[i];
+	remainder.trim();
+}
+
+
+
+/** compares two Integers and returns true if the left hand Integer is less than the right hand Integer
+
+@param rhs is the right hand Integer
+@return true if the left hand Integer is less than the right hand Integer
+
+*/
+
+bool Integer::operator<(const Integer& rhs) const {
+
+	// neither Integer has leading zero limbs, so the one with fewer limbs is smaller
+	if (limb.size() != rhs.limb.size())
+		return limb.size() < rhs.limb.size();
+
+	// if the two Integers have the same amount of limbs, their limbs are compared one by one, starting from the most significant limb
+	for (size_t i = limb.size(); i-- > 0; ) {
+		if (limb[i] != rhs.limb[i])
+			return limb[i] < rhs.limb[i];
+	}
+	return false;
+}
+
+
+
+/** compares two Integers and returns true if the two Integers are equal
+
+@param rhs is the right hand Integer
+@return true if the two Integers are equal
+
+*/
+
+bool Integer::operator==(const Integer& rhs) const {
+
+	// with no leading zero limbs, equal values have identical limbs
+	return limb == rhs.limb;
+}
+
+
+
+/** returns the number of bits needed to write the Integer, 0 for zero
+
+@return the number of bits
+
+*/
+
+size_t Integer::bit_length() const {
+
+	if (limb.empty()) return 0;
+
+	size_t bits = (limb.size() - 1) * LIMB_BITS;
+	for (Limb top = limb.back(); top > 0; top >>= 1)
+		++bits;
+	return bits;
+}
+
+
+
+/** returns one bit of the Integer
+
+@param i is the position of the bit, 0 for the least significant
+@return the bit
+
+*/
+
+bool Integer::test_bit(size_t i) const {
+	return (limb[i / LIMB_BITS] >> (i % LIMB_BITS)) & 1;
+}
+
+
+
+/** prints out the value of the Integer in bits
+
+*/
+
+void Integer::print_as_bits() const {
+
+	std::cout << "(";
+
+	// zero is written as a single 0 bit
+	size_t n = bit_length();
+	if (n == 0) std::cout << 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		std::cout << test_bit(n - 1 - i); // most significant bit first
+	}
+
+	std::cout << ")_2";
+
+}
+
+
+
+/** prints out the value of the Integer as a decimal number
+
+@param out is the stream to print to
+
+*/
+
+void Integer::print_as_int(std::ostream& out) const {
+	out << to_decimal();
+}
+
+
+
+/** converts the Integer to a string of decimal digits. Large values are split by dividing by 10^(19 * 2^k), chosen so both parts are about half as long, and each part is converted the same way; see Integer::write_decimal.
+
+@return the digits, most significant first
+
+*/
+
+std::string Integer::to_decimal() const {
+
+	std::string out;
+	if (limb.empty()) return "0";
+	out.reserve(limb.size() * 20); // a limb has at most 20 decimal digits
+
+	// the top level needs the value below the square of its power, which holds once the value has fewer limbs than the square
+	size_t level = 0;
+	if (limb.size() > DECIMAL_BASE_LIMBS) {
+		while (limb.size() + 1 >= 2 * decimal_power(level).limb.size())
+			++level;
+	}
+
+	write_decimal(level, 0, out);
+	return out;
+}
+
+
+
+/** appends the decimal digits of the Integer to a string. The Integer must be below the square of 10^(19 * 2^level); it is divided by that power and the quotient and remainder are written at the next level down.
+
+@param level is the level of the power to divide by
+@param width is the number of digits to write, padding with leading zeros, or 0 to write no leading zeros
+@param out is the string appended to
+
+*/
+
+void Integer::write_decimal(size_t level, size_t width, std::string& out) const {
+
+	if (limb.size() <= DECIMAL_BASE_LIMBS) {
+
+		// peels off 19 digits at a time, least significant first
+		Limb rest[DECIMAL_BASE_LIMBS];
+		Limb chunks[2 * DECIMAL_BASE_LIMBS];
+		size_t n = limb.size(), count = 0;
+		std::copy(limb.begin(), limb.end(), rest);
+		while (n > 0) {
+			chunks[count++] = divide_small(rest, n, POWERS_OF_TEN[DECIMAL_CHUNK]);
+			while (n > 0 && rest[n - 1] == 0)
+				--n;
+		}
+
+		// writes every chunk but the top one with all 19 digits
+		char digits[DECIMAL_CHUNK];
+		size_t top = 0;
+		for (Limb x = count ? chunks[count - 1] : 0; x > 0; x /= 10)
+			digits[DECIMAL_CHUNK - 1 - top++] = '0' + x % 10;
+		size_t total = top + DECIMAL_CHUNK * (count ? count - 1 : 0);
+
+		if (width > total) out.append(width - total, '0');
+		else if (total == 0) out.push_back('0');
+		out.append(digits + DECIMAL_CHUNK - top, top);
+		for (size_t i = count ? count - 1 : 0; i-- > 0; ) {
+			Limb x = chunks[i];
+			for (size_t j = DECIMAL_CHUNK; j-- > 0; x /= 10)
+				digits[j] = '0' + x % 10;
+			out.append(digits, DECIMAL_CHUNK);
+		}
+		return;
+	}
+
+	Integer quotient, remainder;
+	divide_limbs(*this, decimal_power(level), quotient, remainder);
+	size_t low_width = DECIMAL_CHUNK << level;
+
+	// a zero quotient would only add leading zeros
+	if (width > 0 || !quotient.limb.empty())
+		quotient.write_decimal(level - 1, width > low_width ? width - low_width : 0, out);
+	remainder.write_decimal(level - 1, quotient.limb.empty() && width == 0 ? 0 : low_width, out);
+}
+
+
+
+/** performs addition of two Integers and returns the sum. Assumes that += is defined. A sum too large to be stored inline gets room for a final carry before the copy, so it is allocated exactly once.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return the sum of the two Integers
+
+*/
+
+Integer operator+(const Integer& lhs, const Integer& rhs) {
+
+	// values that fit inline are left to grow only if they carry
+	Integer sum;
+	size_t n = std::max(lhs.limb.size(), rhs.limb.size());
+	if (n > LimbStorage::INLINE_LIMBS)
+		sum.limb.reserve(n + 1);
+	sum.limb = lhs.limb;
+	sum += rhs;
+	return sum;
+}
+
+
+
+/** performs multiplication of two Integers and returns the product. The product is written straight into its own limbs, so it is allocated at most once.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return the product of the two Integers
+
+*/
+
+Integer operator*(const Integer& lhs, const Integer& rhs) {
+
+	Integer product;
+	if (lhs.limb.empty() || rhs.limb.empty())
+		return product;
+
+	size_t nx = lhs.limb.size(), ny = rhs.limb.size();
+
+	// products of small values are trimmed before they are stored, so the ones that fit stay inline
+	if (nx + ny <= 2 * LimbStorage::INLINE_LIMBS) {
+		Integer::Limb small[2 * LimbStorage::INLINE_LIMBS];
+		Integer::multiply_schoolbook(lhs.limb.data(), nx, rhs.limb.data(), ny, small);
+		size_t n = nx + ny;
+		while (small[n - 1] == 0)
+			--n;
+		product.limb.assign(small, small + n);
+		return product;
+	}
+
+	product.limb.resize(nx + ny);
+	Integer::multiply(lhs.limb.data(), nx, rhs.limb.data(), ny, product.limb.data(), Integer::scratch(Integer::multiply_scratch(nx, ny)));
+	product.trim();
+	return product;
+}
+
+
+
+/** divides two Integers and returns the quotient, rounded down
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return the quotient of the two Integers
+@throws std::domain_error if rhs is zero
+
+*/
+
+Integer operator/(const Integer& lhs, const Integer& rhs) {
+
+	Integer quotient, remainder;
+	Integer::divide(lhs, rhs, quotient, remainder);
+	return quotient;
+}
+
+
+
+/** divides two Integers and returns the remainder
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return the remainder of lhs divided by rhs
+@throws std::domain_error if rhs is zero
+
+*/
+
+Integer operator%(const Integer& lhs, const Integer& rhs) {
+
+	Integer quotient, remainder;
+	Integer::divide(lhs, rhs, quotient, remainder);
+	return remainder;
+}
+
+
+
+/** compares two Integers and returns if they are not equal. Assumes that == is defined.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return true if the Integers are not equal
+
+*/
+
+bool operator!=(const Integer& lhs, const Integer& rhs) {
+	return !(lhs == rhs);
+}
+
+
+
+/** compares two Integers and returns if the left hand Integer is greater than the right hand Integer. Assumes that < is defined.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return true if the left hand Integer is greater than the right hand Integer
+
+*/
+
+bool operator>(const Integer& lhs, const Integer& rhs) {
+	return (rhs < lhs);
+}
+
+
+
+/** compares two Integers and returns if the left hand Integer is less than or equal to the right hand Integer. Assumes that > is defined.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return true if the left hand Integer is less than or equal to the right hand Integer
+
+*/
+
+bool operator<=(const Integer& lhs, const Integer& rhs) {
+	return !(lhs > rhs);
+}
+
+
+
+/** compares two Integers and returns if the left hand Integer is greater than or equal to the right hand Integer. Assumes that < is defined.
+
+@param lhs is the left hand Integer
+@param rhs is the right hand Integer
+@return true if the left hand Integer is greater than or equal to the right hand Integer
+
+*/
+
+bool operator>=(const Integer& lhs, const Integer& rhs) {
+	return !(lhs < rhs);
+}
+
+
+
+/** constructor for Montgomery class. Precomputes -1 / N mod 2^64 and R^2 mod N.
+
+@param modulus is the modulus N, odd and greater than 1
+@throws std::invalid_argument if the modulus is even or 1
+
+*/
+
+Montgomery::Montgomery(const Integer& modulus) : n(modulus), size(modulus.limb.size()) {
+
+	if (size == 0 || (modulus.limb[0] & 1) == 0 || (size == 1 && modulus.limb[0] == 1))
+		throw std::invalid_argument("Montgomery: the modulus must be odd and greater than 1");
+
+	// Newton's iteration doubles the correct low bits of 1 / N each step, starting from the 3 that N itself gets right
+	Limb inverse = n.limb[0];
+	for (int i = 0; i < 5; ++i)
+		inverse *= 2 - n.limb[0] * inverse;
+	n_prime = -inverse;
+
+	Integer r;
+	r.limb.assign(2 * size + 1, 0);
+	r.limb[2 * size] = 1;
+	r_squared = r % n;
+}
+
+
+
+/** copies a value below the modulus into an array of exactly as many limbs as the modulus
+
+@param x is the value
+@param out is the array
+
+*/
+
+void Montgomery::load(const Integer& x, Limb* out) const {
+	std::fill(std::copy(x.limb.begin(), x.limb.end(), out), out + size, 0);
+}
+
+
+
+/** makes an Integer from an array of as many limbs as the modulus
+
+@param x is the array
+@return the Integer
+
+*/
+
+Integer Montgomery::store(const Limb* x) const {
+
+	Integer result;
+	result.limb.assign(x, x + size);
+	result.trim();
+	return result;
+}
+
+
+
+/** computes the Montgomery product x * y / R mod N of two arrays with the coarsely integrated operand scanning method: each limb of y is multiplied in and one limb of the result reduced away in the same pass
+
+@param x is the first array, below the modulus
+@param y is the second array, below the modulus
+@param out receives the product, below the modulus; it may be x or y
+
+*/
+
+void Montgomery::multiply(const Limb* x, const Limb* y, Limb* out) const {
+
+	const Limb* m = n.limb.data();
+	Limb* t = Integer::scratch(size + 2);
+	std::fill(t, t + size + 2, 0);
+
+	for (size_t i = 0; i < size; ++i) {
+
+		// t += x * y[i]
+		Limb carry = 0;
+		for (size_t j = 0; j < size; ++j)
+			t[j] = multiply_add_wide(x[j], y[i], t[j], carry, &carry);
+		t[size + 1] = add_with_carry(0, t[size], carry, &t[size]);
+
+		// t = (t + q * N) / 2^64, with q chosen so the low limb becomes zero
+		Limb q = t[0] * n_prime;
+		multiply_add_wide(q, m[0], t[0], 0, &carry);
+		for (size_t j = 1; j < size; ++j)
+			t[j - 1] = multiply_add_wide(q, m[j], t[j], carry, &carry);
+		unsigned char top = add_with_carry(0, t[size], carry, &t[size - 1]);
+		t[size] = t[size + 1] + top;
+	}
+
+	// t is below 2N, so one subtraction at most brings it below N
+	bool reduce = t[size] != 0;
+	if (!reduce) {
+		reduce = true;
+		for (size_t i = size; i-- > 0; ) {
+			if (t[i] != m[i]) {
+				reduce = t[i] > m[i];
+				break;
+			}
+		}
+	}
+	if (reduce)
+		Integer::sub_limbs(t, size + 1, m, size);
+	std::copy(t, t + size, out);
+}
+
+
+
+/** takes a value into Montgomery form
+
+@param x is the value, reduced modulo N first if it is not below it
+@return x * R mod N
+
+*/
+
+Integer Montgomery::to_montgomery(const Integer& x) const {
+
+	std::vector<Limb> a(size), b(size);
+	load(x < n ? x : x % n, a.data());
+	load(r_squared, b.data());
+	multiply(a.data(), b.data(), a.data());
+	return store(a.data());
+}
+
+
+
+/** takes a value out of Montgomery form
+
+@param x is the value in Montgomery form
+@return x / R mod N
+
+*/
+
+Integer Montgomery::from_montgomery(const Integer& x) const {
+
+	std::vector<Limb> a(size), one(size, 0);
+	load(x, a.data());
+	one[0] = 1;
+	multiply(a.data(), one.data(), a.data());
+	return store(a.data());
+}
+
+
+
+/** multiplies two values in Montgomery form
+
+@param x is the first value in Montgomery form
+@param y is the second value in Montgomery form
+@return their product in Montgomery form
+
+*/
+
+Integer Montgomery::multiply(const Integer& x, const Integer& y) const {
+
+	std::vector<Limb> a(size), b(size);
+	load(x, a.data());
+	load(y, b.data());
+	multiply(a.data(), b.data(), a.data());
+	return store(a.data());
+}
+
+
+
+/** raises a value to a power modulo N with a fixed window: the exponent is read WINDOW_BITS bits at a time, squaring WINDOW_BITS times between windows and multiplying by a precomputed power of the base
+
+@param base is the value, in normal form
+@param exponent is the power
+@return base^exponent mod N, in normal form
+
+*/
+
+Integer Montgomery::power(const Integer& base, const Integer& exponent) const {
+
+	// table[i] holds base^i in Montgomery form
+	const size_t entries = size_t(1) << WINDOW_BITS;
+	std::vector<Limb> table(entries * size), result(size);
+	load(to_montgomery(1), table.data());
+	load(to_montgomery(base), table.data() + size);
+	for (size_t i = 2; i < entries; ++i)
+		multiply(table.data() + (i - 1) * size, table.data() + size, table.data() + i * size);
+
+	size_t bits = exponent.bit_length();
+	size_t windows = (bits + WINDOW_BITS - 1) / WINDOW_BITS;
+	std::copy(table.begin(), table.begin() + size, result.begin());
+
+	for (size_t w = windows; w-- > 0; ) {
+		if (w + 1 < windows) {
+			for (int i = 0; i < WINDOW_BITS; ++i)
+				multiply(result.data(), result.data(), result.data());
+		}
+
+		size_t digit = 0;
+		for (int i = WINDOW_BITS; i-- > 0; ) {
+			size_t bit = w * WINDOW_BITS + i;
+			digit = 2 * digit + (bit < bits && exponent.test_bit(bit));
+		}
+		if (digit)
+			multiply(result.data(), table.data() + digit * size, result.data());
+	}
+
+	std::vector<Limb> one(size, 0);
+	one[0] = 1;
+	multiply(result.data(), one.data(), result.data());
+	return store(result.data());
+}
+
+
+
+/** constructor for IntegerBatch class. Every value starts at zero.
+
+@param width is the number of limbs in every value
+@param lanes is the number of values
+
+*/
+
+IntegerBatch::IntegerBatch(size_t width, size_t lanes) : limb(width * lanes, 0), rows(width), count(lanes) {}
+
+
+
+/** stores an Integer in one lane of the batch
+
+@param lane is the value to set, below lanes()
+@param x is the Integer to store, which must fit in width() limbs
+
+*/
+
+void IntegerBatch::set(size_t lane, const Integer& x) {
+
+	size_t n = x.limb.size();
+	if (n > rows)
+		throw std::invalid_argument("Integer is wider than the batch");
+
+	for (size_t i = 0; i < rows; ++i)
+		limb[i * count + lane] = i < n ? x.limb[i] : 0;
+}
+
+
+
+/** reads one lane of the batch back into an Integer
+
+@param lane is the value to read, below lanes()
+@return the value as an Integer
+
+*/
+
+Integer IntegerBatch::get(size_t lane) const {
+
+	Integer x;
+	x.limb.resize(rows);
+	for (size_t i = 0; i < rows; ++i)
+		x.limb[i] = limb[i * count + lane];
+	x.trim();
+	return x;
+}
+
+
+
+/** throws unless another batch has the same width and number of lanes as this one
+
+@param rhs is the other batch
+
+*/
+
+void IntegerBatch::check_shape(const IntegerBatch& rhs) const {
+	if (rhs.rows != rows || rhs.count != count)
+		throw std::invalid_argument("batches differ in width or lanes");
+}
+
+
+
+/** returns the fastest kernel the processor supports
+
+@return AVX2 or SSE42 when the processor has the instructions, otherwise SCALAR
+
+*/
+
+IntegerBatch::Kernel IntegerBatch::best_kernel() {
+
+#if defined(__GNUC__) && defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return AVX2;
+	if (__builtin_cpu_supports("sse4.2")) return SSE42;
+#endif
+	return SCALAR;
+}
+
+
+
+/** returns the kernel to run: the one requested in IntegerBatch::kernel, unless the processor lacks it
+
+@return the kernel
+
+*/
+
+IntegerBatch::Kernel IntegerBatch::active_kernel() {
+	static const Kernel best = best_kernel();
+	return kernel < best ? kernel : best;
+}
+
+
+
+/** adds another batch lane by lane, wrapping modulo 2^(64 width)
+
+@param rhs is the batch to be added, of the same shape
+
+*/
+
+void IntegerBatch::add(const IntegerBatch& rhs) {
+
+	check_shape(rhs);
+	switch (active_kernel()) {
+#if defined(__GNUC__) && defined(__x86_64__)
+	case AVX2: batch_add_avx2(limb.data(), rhs.limb.data(), rows, count); break;
+	case SSE42: batch_add_sse42(limb.data(), rhs.limb.data(), rows, count); break;
+#endif
+	default: batch_add_scalar(limb.data(), rhs.limb.data(), rows, count, 0);
+	}
+}
+
+
+
+/** multiplies every lane by the same small factor, wrapping modulo 2^(64 width)
+
+@param factor is the multiplier
+
+*/
+
+void IntegerBatch::multiply_small(uint32_t factor) {
+
+	switch (active_kernel()) {
+#if defined(__GNUC__) && defined(__x86_64__)
+	case AVX2: batch_multiply_small_avx2(limb.data(), factor, rows, count); break;
+	case SSE42: batch_multiply_small_sse42(limb.data(), factor, rows, count); break;
+#endif
+	default: batch_multiply_small_scalar(limb.data(), factor, rows, count, 0);
+	}
+}
+
+
+
+/** compares two batches lane by lane
+
+@param rhs is the batch to compare with, of the same shape
+@param out receives lanes() flags, 1 where this batch's value is less than rhs's and 0 elsewhere
+
+*/
+
+void IntegerBatch::less(const IntegerBatch& rhs, unsigned char* out) const {
+
+	check_shape(rhs);
+	switch (active_kernel()) {
+#if defined(__GNUC__) && defined(__x86_64__)
+	case AVX2: batch_less_avx2(limb.data(), rhs.limb.data(), rows, count, out); break;
+	case SSE42: batch_less_sse42(limb.data(), rhs.limb.data(), rows, count, out); break;
+#endif
+	default: batch_less_scalar(limb.data(), rhs.limb.data(), rows, count, 0, out);
+	}
+}
+
+
+
+/** adds limb-major values one lane at a time, for the processors without vector kernels and the lanes left over by them
+
+@param x holds the values added to, rows rows of lanes limbs
+@param y holds the values added, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+@param first is the first lane to add
+
+*/
+
+void batch_add_scalar(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, size_t first) {
+
+	for (size_t j = first; j < lanes; ++j) {
+		unsigned char carry = 0;
+		for (size_t i = 0; i < rows; ++i)
+			carry = add_with_carry(carry, x[i * lanes + j], y[i * lanes + j], &x[i * lanes + j]);
+	}
+}
+
+
+
+/** multiplies limb-major values by a small factor one lane at a time
+
+@param x holds the values, rows rows of lanes limbs
+@param factor is the multiplier
+@param rows is the number of limbs per value
+@param lanes is the number of values
+@param first is the first lane to multiply
+
+*/
+
+void batch_multiply_small_scalar(uint64_t* x, uint32_t factor, size_t rows, size_t lanes, size_t first) {
+
+	for (size_t j = first; j < lanes; ++j) {
+		uint64_t carry = 0;
+		for (size_t i = 0; i < rows; ++i)
+			x[i * lanes + j] = multiply_add_wide(x[i * lanes + j], factor, carry, 0, &carry);
+	}
+}
+
+
+
+/** compares limb-major values one lane at a time, from the top limb down
+
+@param x holds the left-hand values, rows rows of lanes limbs
+@param y holds the right-hand values, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+@param first is the first lane to compare
+@param out receives 1 for every lane whose x value is less than its y value and 0 for every other lane
+
+*/
+
+void batch_less_scalar(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, size_t first, unsigned char* out) {
+
+	for (size_t j = first; j < lanes; ++j) {
+		size_t i = rows;
+		while (i > 0 && x[(i - 1) * lanes + j] == y[(i - 1) * lanes + j])
+			--i;
+		out[j] = i > 0 && x[(i - 1) * lanes + j] < y[(i - 1) * lanes + j];
+	}
+}
+
+
+
+#if defined(__GNUC__) && defined(__x86_64__)
+/** adds limb-major values two lanes at a time with SSE4.2. Unsigned overflow is found by comparing with the sign bits flipped, since the signed 64-bit comparison is the only one available.
+
+@param x holds the values added to, rows rows of lanes limbs
+@param y holds the values added, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+
+*/
+
+__attribute__((target("sse4.2"))) void batch_add_sse42(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes) {
+
+	const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+	size_t j = 0;
+	for (; j + 2 <= lanes; j += 2) {
+		__m128i carry = _mm_setzero_si128(); // 0 or 1 in each lane
+		for (size_t i = 0; i < rows; ++i) {
+			__m128i* p = reinterpret_cast<__m128i*>(x + i * lanes + j);
+			__m128i a = _mm_loadu_si128(p);
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i * lanes + j));
+			__m128i sum = _mm_add_epi64(a, b);
+			__m128i total = _mm_add_epi64(sum, carry);
+			// all ones where sum < a or total < carry, unsigned
+			__m128i overflow = _mm_or_si128(_mm_cmpgt_epi64(_mm_xor_si128(a, sign), _mm_xor_si128(sum, sign)), _mm_cmpgt_epi64(_mm_xor_si128(carry, sign), _mm_xor_si128(total, sign)));
+			carry = _mm_srli_epi64(overflow, 63);
+			_mm_storeu_si128(p, total);
+		}
+	}
+	batch_add_scalar(x, y, rows, lanes, j);
+}
+
+
+
+/** multiplies limb-major values by a small factor two lanes at a time with SSE4.2. The vector multiply takes 32 bits from each lane, so every limb is multiplied in two halves; with a 32-bit factor neither the halves nor the carry can overflow 64 bits.
+
+@param x holds the values, rows rows of lanes limbs
+@param factor is the multiplier
+@param rows is the number of limbs per value
+@param lanes is the number of values
+
+*/
+
+__attribute__((target("sse4.2"))) void batch_multiply_small_sse42(uint64_t* x, uint32_t factor, size_t rows, size_t lanes) {
+
+	const __m128i f = _mm_set1_epi64x(factor), low_half = _mm_set1_epi64x(0xFFFFFFFFLL);
+	size_t j = 0;
+	for (; j + 2 <= lanes; j += 2) {
+		__m128i carry = _mm_setzero_si128(); // below the factor in each lane
+		for (size_t i = 0; i < rows; ++i) {
+			__m128i* p = reinterpret_cast<__m128i*>(x + i * lanes + j);
+			__m128i a = _mm_loadu_si128(p);
+			__m128i low = _mm_add_epi64(_mm_mul_epu32(a, f), carry);
+			__m128i high = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), f), _mm_srli_epi64(low, 32));
+			_mm_storeu_si128(p, _mm_or_si128(_mm_slli_epi64(high, 32), _mm_and_si128(low, low_half)));
+			carry = _mm_srli_epi64(high, 32);
+		}
+	}
+	batch_multiply_small_scalar(x, factor, rows, lanes, j);
+}
+
+
+
+/** compares limb-major values two lanes at a time with SSE4.2, from the top limb down, stopping once every lane is decided
+
+@param x holds the left-hand values, rows rows of lanes limbs
+@param y holds the right-hand values, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+@param out receives 1 for every lane whose x value is less than its y value and 0 for every other lane
+
+*/
+
+__attribute__((target("sse4.2"))) void batch_less_sse42(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, unsigned char* out) {
+
+	const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+	size_t j = 0;
+	for (; j + 2 <= lanes; j += 2) {
+		__m128i less = _mm_setzero_si128(), equal = _mm_set1_epi64x(-1);
+		for (size_t i = rows; i-- > 0 && !_mm_testz_si128(equal, equal); ) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i * lanes + j));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i * lanes + j));
+			less = _mm_or_si128(less, _mm_and_si128(equal, _mm_cmpgt_epi64(_mm_xor_si128(b, sign), _mm_xor_si128(a, sign))));
+			equal = _mm_and_si128(equal, _mm_cmpeq_epi64(a, b));
+		}
+		int mask = _mm_movemask_pd(_mm_castsi128_pd(less));
+		out[j] = mask & 1;
+		out[j + 1] = (mask >> 1) & 1;
+	}
+	batch_less_scalar(x, y, rows, lanes, j, out);
+}
+
+
+
+/** adds limb-major values four lanes at a time with AVX2; see batch_add_sse42
+
+@param x holds the values added to, rows rows of lanes limbs
+@param y holds the values added, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+
+*/
+
+__attribute__((target("avx2"))) void batch_add_avx2(uint64_t* x, const uint64_t* y, size_t rows, size_t lanes) {
+
+	const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+	size_t j = 0;
+	for (; j + 4 <= lanes; j += 4) {
+		__m256i carry = _mm256_setzero_si256();
+		for (size_t i = 0; i < rows; ++i) {
+			__m256i* p = reinterpret_cast<__m256i*>(x + i * lanes + j);
+			__m256i a = _mm256_loadu_si256(p);
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i * lanes + j));
+			__m256i sum = _mm256_add_epi64(a, b);
+			__m256i total = _mm256_add_epi64(sum, carry);
+			__m256i overflow = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(sum, sign)), _mm256_cmpgt_epi64(_mm256_xor_si256(carry, sign), _mm256_xor_si256(total, sign)));
+			carry = _mm256_srli_epi64(overflow, 63);
+			_mm256_storeu_si256(p, total);
+		}
+	}
+	batch_add_scalar(x, y, rows, lanes, j);
+}
+
+
+
+/** multiplies limb-major values by a small factor four lanes at a time with AVX2; see batch_multiply_small_sse42
+
+@param x holds the values, rows rows of lanes limbs
+@param factor is the multiplier
+@param rows is the number of limbs per value
+@param lanes is the number of values
+
+*/
+
+__attribute__((target("avx2"))) void batch_multiply_small_avx2(uint64_t* x, uint32_t factor, size_t rows, size_t lanes) {
+
+	const __m256i f = _mm256_set1_epi64x(factor), low_half = _mm256_set1_epi64x(0xFFFFFFFFLL);
+	size_t j = 0;
+	for (; j + 4 <= lanes; j += 4) {
+		__m256i carry = _mm256_setzero_si256();
+		for (size_t i = 0; i < rows; ++i) {
+			__m256i* p = reinterpret_cast<__m256i*>(x + i * lanes + j);
+			__m256i a = _mm256_loadu_si256(p);
+			__m256i low = _mm256_add_epi64(_mm256_mul_epu32(a, f), carry);
+			__m256i high = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), f), _mm256_srli_epi64(low, 32));
+			_mm256_storeu_si256(p, _mm256_or_si256(_mm256_slli_epi64(high, 32), _mm256_and_si256(low, low_half)));
+			carry = _mm256_srli_epi64(high, 32);
+		}
+	}
+	batch_multiply_small_scalar(x, factor, rows, lanes, j);
+}
+
+
+
+/** compares limb-major values four lanes at a time with AVX2; see batch_less_sse42
+
+@param x holds the left-hand values, rows rows of lanes limbs
+@param y holds the right-hand values, in the same layout
+@param rows is the number of limbs per value
+@param lanes is the number of values
+@param out receives 1 for every lane whose x value is less than its y value and 0 for every other lane
+
+*/
+
+__attribute__((target("avx2"))) void batch_less_avx2(const uint64_t* x, const uint64_t* y, size_t rows, size_t lanes, unsigned char* out) {
+
+	const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+	size_t j = 0;
+	for (; j + 4 <= lanes; j += 4) {
+		__m256i less = _mm256_setzero_si256(), equal = _mm256_set1_epi64x(-1);
+		for (size_t i = rows; i-- > 0 && !_mm256_testz_si256(equal, equal); ) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i * lanes + j));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i * lanes + j));
+			less = _mm256_or_si256(less, _mm256_and_si256(equal, _mm256_cmpgt_epi64(_mm256_xor_si256(b, sign), _mm256_xor_si256(a, sign))));
+			equal = _mm256_and_si256(equal, _mm256_cmpeq_epi64(a, b));
+		}
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(less));
+		for (int k = 0; k < 4; ++k)
+			out[j + k] = (mask >> k) & 1;
+	}
+	batch_less_scalar(x, y, rows, lanes, j, out);
+}
+#endif
+
+
+
+#ifdef INTEGER_BENCHMARK
+#include <chrono>
+#include <cstdlib>
+
+static size_t heap_allocations = 0; // calls to the global operator new, for measurement
+
+void* operator new(size_t size) {
+	++heap_allocations;
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+/** returns the seconds elapsed since a starting time
+
+@param start is the starting time
+@return the elapsed seconds
+
+*/
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+/** times adding two Integers of a given width with limbs against the old bit-by-bit addition over a vector of bools
+
+@param bits is the width of the operands
+
+*/
+
+void benchmark_addition(int bits) {
+
+	// builds 2^bits - 1 one bit at a time
+	Integer x = 1;
+	for (int i = 1; i < bits; ++i) {
+		x += x;
+		x += 1;
+	}
+	std::vector<bool> y(bits, true);
+
+	int rounds = (1 << 24) / bits;
+
+	Integer sum = x;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r)
+		sum += x;
+	double limb_time = seconds_since(start) / rounds;
+
+	// the old addition: one branch per bit
+	std::vector<bool> bit_sum = y;
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		int carry_over = 0;
+		for (size_t i = 0; i < y.size(); ++i) {
+			if (i == bit_sum.size()) bit_sum.push_back(0);
+			int new_number = bit_sum[i] + y[i] + carry_over;
+			if (new_number > 1) {
+				bit_sum[i] = new_number - 2;
+				carry_over = 1;
+			}
+			else {
+				bit_sum[i] = new_number;
+				carry_over = 0;
+			}
+		}
+		for (size_t i = y.size(); carry_over && i < bit_sum.size(); ++i) {
+			carry_over = bit_sum[i];
+			bit_sum[i] = !bit_sum[i];
+		}
+		if (carry_over) bit_sum.push_back(1);
+	}
+	double bit_time = seconds_since(start) / rounds;
+
+	std::cerr << "Add " << bits << " bits: limbs " << limb_time << " s, bits " << bit_time << " s, " << bit_time / limb_time << "x" << std::endl;
+}
+
+
+
+/** returns the average time of one call, repeating it until a tenth of a second has passed
+
+@param f is the call to time
+@return the seconds per call
+
+*/
+
+template <typename F>
+double time_per_call(F f) {
+
+	int calls = 0;
+	auto start = std::chrono::steady_clock::now();
+	do {
+		f();
+		++calls;
+	} while (seconds_since(start) < 0.1);
+	return seconds_since(start) / calls;
+}
+
+
+
+/** times squaring an Integer of a given width with each multiplication algorithm on one thread, forcing the choice through the thresholds. Schoolbook is skipped above 2^18 bits, where it takes seconds.
+
+@param bits is the width of the operand, a power of two of at least 64
+
+*/
+
+void benchmark_multiplication(size_t bits) {
+
+	// (2^32 - 5) squared again and again doubles its width each time
+	Integer x = 4294967291u;
+	while (x.bit_length() <= bits / 2) {
+		x *= x;
+		x += 1;
+	}
+
+	size_t karatsuba = Integer::karatsuba_threshold, ntt = Integer::ntt_threshold, threads = Integer::threads;
+	const size_t never = static_cast<size_t>(-1);
+	Integer::threads = 1;
+
+	double schoolbook_time = 0;
+	if (bits <= 1 << 18) {
+		Integer::karatsuba_threshold = never;
+		Integer::ntt_threshold = never;
+		schoolbook_time = time_per_call([&]() {Integer y = x; y *= x;});
+	}
+
+	Integer::karatsuba_threshold = karatsuba;
+	Integer::ntt_threshold = never;
+	double karatsuba_time = time_per_call([&]() {Integer y = x; y *= x;});
+
+	Integer::karatsuba_threshold = 0;
+	Integer::ntt_threshold = 0;
+	double ntt_time = time_per_call([&]() {Integer y = x; y *= x;});
+
+	Integer::karatsuba_threshold = karatsuba;
+	Integer::ntt_threshold = ntt;
+	Integer::threads = threads;
+
+	std::cerr << "Square " << x.bit_length() << " bits: schoolbook ";
+	if (schoolbook_time > 0) std::cerr << schoolbook_time << " s";
+	else std::cerr << "skipped";
+	std::cerr << ", Karatsuba " << karatsuba_time << " s, NTT " << ntt_time << " s" << std::endl;
+}
+
+
+
+/** counts the heap allocations made by comparisons and arithmetic on Integers of a given width. Comparisons and compound assignments whose result fits in the limbs already held should make none; the free operators make one for a result too large to be stored inline.
+
+@param bits is the width of the operands
+
+*/
+
+void benchmark_allocations(size_t bits) {
+
+	Integer x = 4294967291u;
+	while (x.bit_length() <= bits / 2) {
+		x *= x;
+		x += 1;
+	}
+	Integer y = x + 12345;
+
+	const int rounds = 100;
+	volatile bool answers = false; // keeps the comparisons from being optimized away
+
+	size_t allocations = heap_allocations;
+	for (int r = 0; r < rounds; ++r)
+		answers = answers ^ (x < y) ^ (x == y) ^ (x != y) ^ (x >= y);
+	size_t compare_count = heap_allocations - allocations;
+
+	// both results have spare room: the sum one carry limb, the product the product of the two widths
+	Integer sum = x + x;
+	Integer product = x * y;
+	Integer one = 1;
+	product *= one; // grows the scratch space once, before counting
+
+	allocations = heap_allocations;
+	for (int r = 0; r < rounds; ++r)
+		sum += one;
+	size_t add_count = heap_allocations - allocations;
+
+	allocations = heap_allocations;
+	for (int r = 0; r < rounds; ++r) {
+		product = x;
+		product *= y;
+	}
+	size_t multiply_count = heap_allocations - allocations;
+
+	allocations = heap_allocations;
+	for (int r = 0; r < rounds; ++r) {
+		Integer s = x + y;
+		Integer p = x * y;
+		answers = answers ^ (s < p);
+	}
+	size_t operator_count = heap_allocations - allocations;
+
+	std::cerr << "Allocations per operation at " << x.bit_length() << " bits: comparisons " << compare_count / (4.0 * rounds) << ", += " << add_count / double(rounds) << ", *= " << multiply_count / double(rounds) << ", + and * " << operator_count / (2.0 * rounds) << std::endl;
+}
+
+
+
+/** times and counts the heap allocations of building, copying, adding and multiplying arrays of Integers small enough to be stored inline. Only the arrays themselves should allocate.
+
+@param n is the number of Integers in each array
+
+*/
+
+void benchmark_small_integers(int n) {
+
+	size_t allocations = heap_allocations;
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<Integer> x, y;
+	x.reserve(n);
+	y.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		x.push_back(Integer(4000000000u - i) * Integer(4000000000u - i)); // about 2^64, so two limbs
+		y.push_back(Integer(i + 1));
+	}
+	std::vector<Integer> z = x; // copy
+
+	for (int i = 0; i < n; ++i) {
+		z[i] += y[i];
+		z[i] *= y[i];
+	}
+
+	double time = seconds_since(start) / n;
+	size_t count = heap_allocations - allocations;
+
+	std::cerr << n << " small Integers of " << sizeof(Integer) << " bytes: " << time << " s and " << count << " allocations to build, copy, add and multiply, " << count / double(n) << " per Integer" << std::endl;
+}
+
+
+
+/** times parsing a decimal string of a given length into an Integer and printing it back, and checks that the digits survive the round trip
+
+@param digits is the number of decimal digits
+
+*/
+
+void benchmark_decimal(size_t digits) {
+
+	// pseudo-random digits with a nonzero first digit
+	std::string text(digits, '0');
+	uint32_t seed = 12345;
+	for (auto& c : text) {
+		seed = seed * 1664525u + 1013904223u;
+		c = '0' + (seed >> 16) % 10;
+	}
+	text[0] = '7';
+
+	auto start = std::chrono::steady_clock::now();
+	Integer x(text);
+	double parse_time = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	std::string printed = x.to_decimal();
+	double print_time = seconds_since(start);
+
+	std::cerr << "Decimal " << digits << " digits: parse " << parse_time << " s, print " << print_time << " s" << (printed == text ? "" : ", ROUND TRIP FAILED") << std::endl;
+}
+
+
+
+/** times raising a value to a power of the same width modulo an odd modulus, with the Montgomery context against square-and-multiply with a division after every product, and checks that both agree
+
+@param bits is the width of the modulus, base and exponent
+
+*/
+
+void benchmark_modular_power(size_t bits) {
+
+	// pseudo-random binary digits, with the top one set
+	uint32_t seed = static_cast<uint32_t>(bits);
+	auto random_bits = [&]() {
+		std::string text(bits, '0');
+		for (auto& c : text) {
+			seed = seed * 1664525u + 1013904223u;
+			c = '0' + (seed >> 31);
+		}
+		text[0] = '1';
+		return text;
+	};
+	std::string modulus_bits = random_bits(), exponent_bits = random_bits();
+	modulus_bits[bits - 1] = '1'; // odd
+	Integer modulus(modulus_bits, 2), base(random_bits(), 2), exponent(exponent_bits, 2);
+	base %= modulus;
+
+	Montgomery context(modulus);
+	Integer fast;
+	double montgomery_time = time_per_call([&]() {fast = context.power(base, exponent);});
+
+	Integer slow;
+	double division_time = time_per_call([&]() {
+		slow = 1;
+		for (char c : exponent_bits) {
+			slow = slow * slow % modulus;
+			if (c == '1') slow = slow * base % modulus;
+		}
+	});
+
+	std::cerr << "Modular power at " << bits << " bits: Montgomery " << montgomery_time << " s, division " << division_time << " s" << (fast == slow ? "" : ", RESULTS DIFFER") << std::endl;
+}
+
+
+
+/** times adding, comparing and multiplying by a small factor many 256-bit values, one Integer at a time against the batch with each kernel the processor supports, and checks that the results agree
+
+@param lanes is the number of values
+
+*/
+
+void benchmark_batch(size_t lanes) {
+
+	const size_t width = 4;
+	const uint32_t factor = 1000003;
+
+	// pseudo-random values well below 2^256, so that the sums and products fit in the Integers too
+	uint32_t seed = static_cast<uint32_t>(lanes);
+	std::vector<Integer> x(lanes), y(lanes);
+	for (size_t j = 0; j < lanes; ++j) {
+		for (size_t i = 0; i < 6; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			x[j] *= 1u << 31;
+			x[j] += seed >> 1;
+			seed = seed * 1664525u + 1013904223u;
+			y[j] *= 1u << 31;
+			y[j] += seed >> 1;
+		}
+	}
+
+	std::vector<Integer> sums;
+	std::vector<unsigned char> flags(lanes);
+	Integer scale = factor;
+	double add_time = time_per_call([&]() {
+		sums = x;
+		for (size_t j = 0; j < lanes; ++j)
+			sums[j] += y[j];
+	});
+	double less_time = time_per_call([&]() {
+		for (size_t j = 0; j < lanes; ++j)
+			flags[j] = x[j] < y[j];
+	});
+	double multiply_time = time_per_call([&]() {
+		sums = x;
+		for (size_t j = 0; j < lanes; ++j)
+			sums[j] *= scale;
+	});
+	std::cerr << "Batch of " << lanes << " values, Integer: add " << add_time << " s, less " << less_time << " s, multiply " << multiply_time << " s" << std::endl;
+
+	static const char* const names[] = {"scalar", "SSE4.2", "AVX2"};
+	IntegerBatch::Kernel requested = IntegerBatch::kernel;
+	for (int k = IntegerBatch::SCALAR; k <= IntegerBatch::best_kernel(); ++k) {
+		IntegerBatch::kernel = IntegerBatch::Kernel(k);
+
+		IntegerBatch a(width, lanes), b(width, lanes), c(width, lanes);
+		for (size_t j = 0; j < lanes; ++j) {
+			a.set(j, x[j]);
+			b.set(j, y[j]);
+		}
+		std::vector<unsigned char> batch_flags(lanes);
+
+		add_time = time_per_call([&]() {
+			c = a;
+			c.add(b);
+		});
+		bool agree = true;
+		for (size_t j = 0; j < lanes; ++j)
+			agree = agree && c.get(j) == x[j] + y[j];
+
+		less_time = time_per_call([&]() {a.less(b, batch_flags.data());});
+		agree = agree && batch_flags == flags;
+
+		multiply_time = time_per_call([&]() {
+			c = a;
+			c.multiply_small(factor);
+		});
+		for (size_t j = 0; j < lanes; ++j)
+			agree = agree && c.get(j) == x[j] * scale;
+
+		std::cerr << "Batch of " << lanes << " values, " << names[k] << ": add " << add_time << " s, less " << less_time << " s, multiply " << multiply_time << " s" << (agree ? "" : ", RESULTS DIFFER") << std::endl;
+	}
+	IntegerBatch::kernel = requested;
+}
+
+
+
+/** times building the first levels of the decimal powers at run time, by squaring Integers, against copying them from the table the compiler built, and checks that both agree
+
+*/
+
+void benchmark_fixed_powers() {
+
+	const size_t levels = sizeof(DECIMAL_POWER_TABLE) / sizeof(DECIMAL_POWER_TABLE[0]);
+	std::vector<Integer> squared, copied;
+
+	double square_time = time_per_call([&]() {
+		squared.assign(1, Integer("10000000000000000000"));
+		while (squared.size() < levels)
+			squared.push_back(squared.back() * squared.back());
+	});
+	double copy_time = time_per_call([&]() {
+		copied.clear();
+		for (const auto& power : DECIMAL_POWER_TABLE)
+			copied.push_back(Integer(power));
+	});
+
+	std::cerr << "Decimal powers to level " << levels - 1 << ": squared " << square_time << " s, compile-time table " << copy_time << " s" << (squared == copied ? "" : ", RESULTS DIFFER") << std::endl;
+}
+
+
+
+/** times multiplying two Integers of a given width on 1, 2, 4 and 8 threads and reports the speedup over one thread, checking that every thread count gives the same product
+
+@param bits is the width of the operands
+
+*/
+
+void benchmark_parallel_multiplication(size_t bits) {
+
+	// (2^32 - 5) squared again and again doubles its width each time
+	Integer x = 4294967291u;
+	while (x.bit_length() <= bits / 2) {
+		x *= x;
+		x += 1;
+	}
+	Integer y = x + 12345;
+
+	size_t threads = Integer::threads;
+	Integer serial;
+	double serial_time = 0;
+	std::cerr << "Multiply " << x.bit_length() << " bits:";
+	for (size_t n = 1; n <= 8; n *= 2) {
+		Integer::threads = n;
+		Integer product;
+		double time = time_per_call([&]() {product = x * y;});
+		if (n == 1) {
+			serial = product;
+			serial_time = time;
+		}
+		std::cerr << " " << n << (n == 1 ? " thread " : " threads ") << time << " s (" << serial_time / time << "x)" << (product == serial ? "" : " RESULTS DIFFER") << (n < 8 ? "," : "");
+	}
+	std::cerr << std::endl;
+	Integer::threads = threads;
+}
+#endif